@@ -4,6 +4,10 @@
 #include <QObject>
 #include <QString>
 #include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QVariantList>
+#include <memory>
 #include "ScannerManager.h"
 #include "PaymentManager.h"
 #include "EmailManager.h"
@@ -17,6 +21,12 @@ class AppController : public QObject {
     Q_PROPERTY(int price READ price NOTIFY priceChanged)
     Q_PROPERTY(int currentScan READ currentScan NOTIFY currentScanChanged)
     Q_PROPERTY(bool isScanning READ isScanning NOTIFY isScanningChanged)
+    Q_PROPERTY(int processingCount READ processingCount NOTIFY processingCountChanged)
+    Q_PROPERTY(int scanProgress READ scanProgress NOTIFY scanProgressChanged)
+    Q_PROPERTY(bool waitingForDocument READ waitingForDocument NOTIFY waitingForDocumentChanged)
+    Q_PROPERTY(QString scanError READ scanError NOTIFY scanErrorChanged)
+    Q_PROPERTY(QString mediaProfile READ mediaProfile NOTIFY mediaProfileChanged)
+    Q_PROPERTY(QVariantList mediaProfiles READ mediaProfiles CONSTANT)
 
 public:
     explicit AppController(AppSettings* settings, QObject* parent = nullptr);
@@ -29,7 +39,13 @@ public:
     int credits() const { return m_credits; }
     int price() const { return m_price; }
     int currentScan() const { return m_currentScan; }
-    bool isScanning() const { return m_isScanning; }
+    bool isScanning() const { return m_isScanning; }     // the scanner, not processing
+    int processingCount() const { return m_pendingJobs.size(); }
+    int scanProgress() const { return m_scanProgress; }
+    bool waitingForDocument() const { return m_waitingForDocument; }
+    QString scanError() const { return m_scanError; }   // why the last scan stopped, empty if it didn't
+    QString mediaProfile() const;
+    QVariantList mediaProfiles() const;   // [{id, name}], auto-detect first where available
 
 public slots:
     // Workflow control
@@ -39,6 +55,7 @@ public slots:
     void startScanning();
     void performNextScan();
     void executeScan();
+    void setMediaProfile(const QString& profileId);
     void cancelSession();
     void resetToIdle();
 
@@ -46,7 +63,11 @@ private slots:
     // Scanner event handlers
     void onScannerDetected(const QString& deviceName);
     void onScannerNotFound();
-    void onScanCompleted(const QString& filePath);
+    void onScanProgress(int percentage);
+    void onDocumentMissing();
+    void onDocumentDetected();
+    void onScanCompleted(const ScanFrame& frame);
+    void onBatchFinished(int pagesScanned, const QString& errorMessage);
     void onScanFailed(const QString& errorMessage);
 
     // Payment event handlers
@@ -56,8 +77,8 @@ private slots:
     void onPaymentTimeout();
 
     // Image processing handlers
-    void onProcessingCompleted(const QString& outputPath);
-    void onProcessingFailed(const QString& errorMessage);
+    void onProcessingCompleted(int jobId, const QString& outputPath, const QStringList& framePaths);
+    void onProcessingFailed(int jobId, const QString& errorMessage);
 
     // Email handlers
     void onEmailSent();
@@ -70,6 +91,11 @@ signals:
     void priceChanged();
     void currentScanChanged();
     void isScanningChanged();
+    void processingCountChanged();
+    void scanProgressChanged();
+    void waitingForDocumentChanged();
+    void scanErrorChanged();
+    void mediaProfileChanged();
 
     // Workflow signals
     void scanningCompleted();
@@ -77,7 +103,13 @@ signals:
 private:
     void connectSignals();
     void sendEmail();
+    void sendEmailWhenComplete();
     void cleanupScans();
+    void updateScanningState();
+    void setWaitingForDocument(bool waiting);
+    void setScanError(const QString& errorMessage);
+    QString stripPath(int strip, bool back) const;
+    void dropBackSide(int strip);
 
     AppSettings* m_settings;
 
@@ -93,8 +125,27 @@ private:
     int m_price;
     int m_currentScan;
     bool m_isScanning;
+    int m_scanProgress;
+    bool m_waitingForDocument;
+    QString m_scanError;
     QStringList m_scanPaths;
     QString m_sessionId;
+
+    // Scan in flight: one streaming pipeline per page, and the strip number
+    // given to each page of the batch
+    QList<std::shared_ptr<ScanPipeline>> m_pagePipelines;
+    QHash<int, int> m_batchStrips;
+    QString m_batchSessionId;   // session that started the batch; other frames are dropped
+    int m_stripCount;   // strips scanned this session, numbers the output files
+    QSet<int> m_failedStrips;   // strips whose front failed; their back sides are dropped
+
+    // Processing jobs of scanned sides, by job id. Backs of duplex strips
+    // are delivered with the session but use no credit.
+    struct StripJob {
+        int strip;
+        bool back;
+    };
+    QHash<int, StripJob> m_pendingJobs;
 };
 
 #endif // APPCONTROLLER_H
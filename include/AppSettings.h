@@ -22,7 +22,29 @@ public:
     int scannerDpi;
     QString scannerMode;
     QString scannerFormat;
+    QString scannerSource; // SANE "source" option (card feeder front side)
+    bool duplexScan;       // Capture the back of each strip in the same pass
+    QString duplexSource;  // SANE "source" used for duplex scans
     QString scannerDevice; // Device name for fi-800R
+    bool scannerJpeg;      // Let the scanner compress; the JPEG is cropped losslessly, but only
+                           // after the page is in (no streaming pipeline)
+    int maxScanners;       // Scanners used at once; pages go to whichever is idle
+    bool previewScan;      // Low-dpi pass to limit the final scan to the photo (flatbed sources only;
+                           // a feeder ejects the card after one pass, so there is no preview)
+    int previewDpi;
+    bool batchScan;        // Feed all purchased strips in one scan session
+    QString mediaProfile;  // Default media profile id, "auto" to detect from the preview
+                           // (flatbed only; feeders fall back to the first profile)
+
+    // Simulated scanner for benchmarking the capture path without hardware
+    bool simulatedScanner;
+    int simLinesPerSecond;
+    int simStartLatencyMs;
+    int simJitterPercent;
+    int simJamPercent;     // chance per page of a paper jam
+    int simTimeoutPercent; // chance per page of a stalled transfer
+    int simFeederPages;    // pages in the feeder per batch
+    int simScannerCount;   // number of simulated scanners
 
     // Crop dimensions (will be adjusted for fi-800R if needed)
     int cropX1, cropY1, cropX2, cropY2;
@@ -52,6 +74,14 @@ public:
     // Image processing
     int jpegQuality;
     int cropDetectionThreshold;
+    bool streamingPipeline; // Crop and encode while the page is still feeding
+    bool grayscaleDetection; // Scan and save black-and-white photos as one channel
+    bool splitFrames;       // Also deliver each frame of a photo strip as its own photo
+    bool deskew;            // Straighten photos that were fed at an angle
+    int spillThresholdMb;   // Spill captured pages to disk below this much free memory (0 = never)
+    int processingWorkers;  // Pages processed at the same time
+    int processingMemoryMb; // Memory the running jobs may use (0 = half of what is free at startup)
+    bool bufferPool;        // Reuse image buffers across scans instead of allocating them each time
 
     // UI Settings
     int windowWidth;
@@ -62,6 +92,8 @@ public:
     QMap<QString, QString> getSquareHeaders() const;
     double getPriceDollars(int quantity) const;
     int getPriceCents(int quantity) const;
+    QString scanSource() const;   // SANE source of the next scans, duplex or not
+    bool isSheetFed() const;      // scanSource() is a feeder rather than a flatbed
 
 private:
     void createDirectories();
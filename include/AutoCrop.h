@@ -4,6 +4,7 @@
 #include <opencv2/opencv.hpp>
 #include <QString>
 #include <QRect>
+#include <QList>
 #include <QDebug>
 
 class AutoCrop {
@@ -11,11 +12,12 @@ public:
     struct CropResult {
         bool success;
         QRect cropRect;
+        double angle;   // skew in degrees, positive when the top edge falls to the right
         QString errorMessage;
 
-        CropResult() : success(false) {}
-        CropResult(const QRect& rect) : success(true), cropRect(rect) {}
-        CropResult(const QString& error) : success(false), errorMessage(error) {}
+        CropResult() : success(false), angle(0.0) {}
+        CropResult(const QRect& rect, double skew = 0.0) : success(true), cropRect(rect), angle(skew) {}
+        CropResult(const QString& error) : success(false), angle(0.0), errorMessage(error) {}
     };
 
     AutoCrop();
@@ -27,12 +29,50 @@ public:
     // Alternative: Detect from OpenCV Mat directly
     CropResult detectPhotoBounds(const cv::Mat& image, int threshold = 50);
 
+    // True if the image has no noticeable colour, e.g. a black-and-white photo
+    bool isGrayscale(const cv::Mat& image) const;
+
+    // Frames of a cropped photo-booth strip, split at the white gutters along
+    // its long side. Empty unless there are at least two similar frames.
+    QList<QRect> detectFrames(const cv::Mat& strip, int threshold) const;
+
+    // True if a skew angle is large enough to straighten and small enough to trust
+    static bool needsDeskew(double angle);
+
+    // Counts, per row and per column, the pixels whose darkest channel is below
+    // threshold. One pass over the image, vectorized where the CPU allows it.
+    static void darknessProfiles(const cv::Mat& image, int threshold, std::vector<int>& rowCounts,
+                                 std::vector<int>& columnCounts);
+
+    // Straightened crop of a photo whose bounding rect and skew are known: one
+    // warpAffine that only produces the output pixels
+    cv::Mat cropDeskewed(const cv::Mat& image, const QRect& bounds, double angle) const;
+
     // Apply perspective correction if needed
     cv::Mat correctPerspective(const cv::Mat& image, const std::vector<cv::Point>& corners);
 
 private:
+    // Fast path for a white background: bounds from row and column darkness
+    // profiles, pixels below threshold count as dark. False if the profiles
+    // do not look like a single solid photo (confidence below the minimum).
+    bool findProfileBounds(const cv::Mat& image, int threshold, cv::Rect& bounds, double& confidence) const;
+
+    // Skew of the photo inside bounds, from the first dark pixels below its
+    // top edge and above its bottom edge
+    double estimateSkew(const cv::Mat& image, const cv::Rect& bounds, int threshold) const;
+
+    // Coarse-to-fine: contour on a downscaled copy, edges refined at full size.
+    // angle receives the skew of the detected quad.
+    std::vector<cv::Point> findPhotoCorners(const cv::Mat& image, int threshold, double& angle);
+
     // Find the largest rectangular contour (the photo)
     std::vector<cv::Point> findLargestRectangle(const cv::Mat& image, int threshold);
+    // Same, on an image already converted to gray and blurred
+    std::vector<cv::Point> findRectangleInBlurred(const cv::Mat& blurred, int threshold);
+
+    // Moves each side of a coarse box to the sub-pixel edge found in a narrow
+    // band of the full-size image around it
+    cv::Rect refineBounds(const cv::Mat& image, const cv::Rect& coarse, int scale) const;
 
     // Order points for perspective transform (top-left, top-right, bottom-right, bottom-left)
     std::vector<cv::Point> orderPoints(const std::vector<cv::Point>& points);
@@ -3,10 +3,24 @@
 
 #include <QObject>
 #include <QString>
+#include <QStringList>
+#include <QList>
+#include <QHash>
+#include <QQueue>
 #include <QFuture>
+#include <QThreadPool>
+#include <QSize>
+#include <QPoint>
+#include <functional>
+#include <memory>
 #include "AppSettings.h"
 #include "AutoCrop.h"
+#include "ScanPipeline.h"
 
+// Crops and encodes scanned pages as jobs on its own worker pool. Jobs wait
+// in a queue until a worker is free and their working memory fits the
+// budget; the results of a session are reported in the order its jobs were
+// started, however the jobs overlap.
 class ImageProcessor : public QObject {
     Q_OBJECT
 
@@ -14,21 +28,95 @@ public:
     explicit ImageProcessor(AppSettings* settings, QObject* parent = nullptr);
     ~ImageProcessor();
 
-    void processImage(const QString& inputPath, const QString& outputPath);
+    // Each returns the id of the job, carried by the processing signals.
+    // removeInput deletes the input file once it has been processed.
+    int processImage(const QString& inputPath, const QString& outputPath, bool removeInput = false);
+    int processImage(const cv::Mat& image, const QString& outputPath,
+                     std::shared_ptr<ScanPipeline> pipeline = nullptr);
+    // Scanner-side JPEG: cropped in the DCT domain, never re-encoded
+    int processJpeg(const QByteArray& jpeg, const QString& outputPath);
+
+    // Largest output of the jobs started from now on (either orientation);
+    // bigger crops are scaled down. An empty size keeps the scan size.
+    void setOutputSize(const QSize& size) { m_outputSize = size; }
+    // Session of the jobs started from now on
+    void setSessionId(const QString& sessionId) { m_sessionId = sessionId; }
+    // Drops the queued jobs of a session; its running jobs finish unreported
+    void cancelSession(const QString& sessionId);
+    // Jobs queued or running
+    int pendingJobs() const { return m_queue.size() + m_runningJobs; }
 
 signals:
-    void processingStarted();
+    void processingStarted(int jobId);
     void processingProgress(int percentage);
-    void processingCompleted(const QString& outputPath);
-    void processingFailed(const QString& errorMessage);
+    // framePaths: the separate photos of a strip, if it was split
+    void processingCompleted(int jobId, const QString& outputPath, const QStringList& framePaths);
+    void processingFailed(int jobId, const QString& errorMessage);
 
 private:
     AppSettings* m_settings;
-    QFuture<void> m_processingFuture;
     AutoCrop m_autoCrop;
+    QSize m_outputSize;
+    QString m_sessionId;
+
+    struct Job {
+        int id;
+        QString sessionId;
+        qint64 memoryBytes;     // working memory estimate, counted against the budget
+        // Runs on a worker; fills the frames or the error message
+        std::function<bool(QStringList& framePaths, QString& errorMessage)> run;
+        std::function<void()> discard;  // cleans up the input of a dropped job
+        QString outputPath;
+    };
+    struct Result {
+        bool success = false;
+        QString outputPath;
+        QStringList framePaths;
+        QString errorMessage;
+    };
+
+    // Job queue; everything but Job::run is touched on the owner's thread only
+    QThreadPool m_workerPool;
+    QQueue<Job> m_queue;
+    QHash<QString, QList<int>> m_sessionJobs;   // started jobs per session, not yet reported
+    QHash<int, Result> m_results;
+    int m_nextJobId;
+    int m_runningJobs;
+    qint64 m_runningBytes;
+    qint64 m_memoryBudget;
+
+    int enqueue(Job job);
+    void dispatchJobs();
+    void onJobFinished(const QString& sessionId, int jobId, qint64 memoryBytes, const Result& result);
+    void reportResults(const QString& sessionId);
+
+    bool processImageTask(const cv::Mat& image, const QString& outputPath, const QSize& outputSize,
+                          QStringList& framePaths, std::shared_ptr<ScanPipeline> pipeline = nullptr);
+    cv::Mat loadImage(const QString& inputPath);
+    // Spilled TIFF pages: decodes only the area around the photo, empty if not
+    // a readable TIFF. origin receives the position of that area in the page.
+    cv::Mat loadTiffRegion(const QString& inputPath, QPoint& origin);
+    // origin: position of cvImage in the scanned page, for the manual crop fallback
+    bool cropAndConvert(const cv::Mat& cvImage, const QString& outputPath, const QSize& outputSize,
+                        QStringList& framePaths, const QPoint& origin = QPoint());
+    bool cropJpeg(const QByteArray& jpeg, const QString& outputPath, QStringList& framePaths);
+    QRect manualCropRect(int imageWidth, int imageHeight) const;
+    int jpegQuality() const;
+    // Encodes on the worker pool; falls back to cv::imwrite for layouts the striped encoder lacks
+    bool saveJpeg(const cv::Mat& image, const QString& path, int quality);
 
-    void processImageTask(const QString& inputPath, const QString& outputPath);
-    bool cropAndConvert(const QString& inputPath, const QString& outputPath);
+    // Frames of a strip being saved on the worker pool
+    struct FrameJobs {
+        QStringList paths;
+        QList<QFuture<bool>> results;
+    };
+    FrameJobs startFrames(const cv::Mat& strip, const QString& outputPath, int quality);
+    FrameJobs startJpegFrames(const QByteArray& jpeg, const QList<QRect>& frames,
+                              const QString& outputPath, bool grayscale);
+    // Waits for the frames; returns the ones that were written
+    QStringList finishFrames(FrameJobs& jobs);
+    static void removeFiles(const QStringList& paths);
+    static QString framePath(const QString& outputPath, int frame);
 };
 
 #endif // IMAGEPROCESSOR_H
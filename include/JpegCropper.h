@@ -0,0 +1,26 @@
+#ifndef JPEGCROPPER_H
+#define JPEGCROPPER_H
+
+#include <QByteArray>
+#include <QRect>
+#include <QSize>
+#include <opencv2/core.hpp>
+
+// Works on JPEGs delivered by the scanner without a full decode/re-encode.
+//
+// thumbnail() uses libjpeg's DCT-domain downscaling, so only a fraction of
+// the coefficients are inverse-transformed. crop() copies the DCT
+// coefficients of the wanted region into a new file like jpegtran -crop,
+// which is lossless; the left/top edges snap to the 8/16 pixel MCU grid.
+// With grayscale set only the luma component is kept (jpegtran -grayscale).
+class JpegCropper {
+public:
+    // Decode at 1/scaleDenom size (1, 2, 4 or 8) into a BGR or gray Mat
+    static bool thumbnail(const QByteArray& jpeg, int scaleDenom, cv::Mat& image, QSize& fullSize);
+
+    // Crop to rect (full-size pixels); cropped receives the rect actually used
+    static bool crop(const QByteArray& jpeg, const QRect& rect, QByteArray& output, QRect& cropped,
+                     bool grayscale = false);
+};
+
+#endif // JPEGCROPPER_H
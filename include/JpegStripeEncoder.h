@@ -0,0 +1,46 @@
+#ifndef JPEGSTRIPEENCODER_H
+#define JPEGSTRIPEENCODER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QThreadPool>
+#include <opencv2/core.hpp>
+
+// Baseline JPEG encoder that works in horizontal stripes.
+//
+// Every stripe is compressed on its own as exactly one restart interval, so
+// stripes can be encoded as soon as their rows are available (or in any
+// order) and then stitched into a single valid JPEG by joining the
+// entropy-coded segments with RSTn markers.
+class JpegStripeEncoder {
+public:
+    JpegStripeEncoder(int width, int channels, int quality, int dpi = 0);
+
+    bool isValid() const;
+    int width() const { return m_width; }
+
+    // Rows per stripe; every stripe except the last must have exactly this height
+    int stripeRows() const { return m_stripeRows; }
+
+    // Compress one stripe (BGR or grayscale rows) into a standalone JPEG.
+    // Safe to call from several threads at once.
+    bool encodeStripe(const cv::Mat& rows, QByteArray& stripe) const;
+
+    // Join stripes, in image order, into one baseline JPEG
+    bool stitch(const QList<QByteArray>& stripes, QByteArray& jpeg) const;
+
+    // Encode a whole image, its stripes in parallel on pool
+    bool encode(const cv::Mat& image, QByteArray& jpeg,
+                QThreadPool* pool = QThreadPool::globalInstance()) const;
+
+private:
+    int m_width;
+    int m_channels;
+    int m_quality;
+    int m_dpi;
+    int m_mcuRows;
+    int m_stripeRows;
+    int m_restartInterval;
+};
+
+#endif // JPEGSTRIPEENCODER_H
@@ -0,0 +1,42 @@
+#ifndef MATBUFFERPOOL_H
+#define MATBUFFERPOOL_H
+
+#include <QMutex>
+#include <map>
+#include <unordered_map>
+#include <opencv2/core.hpp>
+
+// cv::MatAllocator that keeps large freed buffers for the next Mat of about
+// the same size. Scans, crops and their intermediates are the same few sizes
+// page after page, so once the pool is warm the processing path no longer
+// allocates (or faults in) fresh multi-megabyte buffers. Small buffers go
+// straight to cv::fastMalloc.
+class MatBufferPool : public cv::MatAllocator {
+public:
+    // Makes a pool keeping up to maxIdleBytes of free buffers the default
+    // allocator of every cv::Mat. The pool lives until the process exits.
+    static void install(size_t maxIdleBytes);
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override;
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags,
+                  cv::UMatUsageFlags usageFlags) const override;
+    void deallocate(cv::UMatData* data) const override;
+
+private:
+    explicit MatBufferPool(size_t maxIdleBytes);
+
+    uchar* takeBuffer(size_t bytes) const;
+    // False if the buffer is not from the pool
+    bool returnBuffer(uchar* buffer) const;
+    static size_t roundCapacity(size_t bytes);
+
+    const size_t m_maxIdleBytes;
+    mutable QMutex m_mutex;
+    mutable std::multimap<size_t, uchar*> m_idle;            // capacity -> free buffer
+    mutable std::unordered_map<uchar*, size_t> m_capacity;   // every pooled buffer, idle or in use
+    mutable size_t m_idleBytes;
+    mutable size_t m_pooledBytes;
+};
+
+#endif // MATBUFFERPOOL_H
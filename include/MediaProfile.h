@@ -0,0 +1,47 @@
+#ifndef MEDIAPROFILE_H
+#define MEDIAPROFILE_H
+
+#include <QString>
+#include <QList>
+#include <QSize>
+#include <QSizeF>
+#include "AppSettings.h"
+
+// Scan parameters for one kind of media the kiosk accepts
+struct MediaProfile {
+    QString id;
+    QString name;
+    QSizeF sizeMm;      // media size in feed direction; empty scans the full area
+    int dpi;
+    QString mode;       // SANE scan mode
+    QSize outputSize;   // largest delivered image; empty keeps the scan size
+
+    MediaProfile() : dpi(0) {}
+
+    bool isValid() const { return !id.isEmpty(); }
+    bool hasSize() const { return !sizeMm.isEmpty(); }
+};
+
+// Built-in media profiles. Immutable after construction, so it can be read
+// from the scanner threads.
+class MediaProfileRegistry {
+public:
+    static const char* const AutoDetect;   // pseudo profile: detect from the preview
+
+    explicit MediaProfileRegistry(AppSettings* settings);
+
+    const QList<MediaProfile>& profiles() const { return m_profiles; }
+    const MediaProfile& defaultProfile() const { return m_profiles.first(); }
+
+    // Invalid profile if the id is unknown
+    MediaProfile find(const QString& id) const;
+
+    // Profile whose media size matches a photo measured in a preview (either
+    // orientation), or an invalid profile if none is close enough
+    MediaProfile match(const QSizeF& photoMm) const;
+
+private:
+    QList<MediaProfile> m_profiles;
+};
+
+#endif // MEDIAPROFILE_H
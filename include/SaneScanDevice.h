@@ -0,0 +1,38 @@
+#ifndef SANESCANDEVICE_H
+#define SANESCANDEVICE_H
+
+#include <atomic>
+#include <mutex>
+#include "ScanDevice.h"
+
+// Scanner driven through a libsane backend
+class SaneScanDevice : public ScanDevice {
+public:
+    SaneScanDevice();
+    ~SaneScanDevice() override;
+
+    SANE_Status open(const QString& deviceName) override;
+    void close() override;
+    bool isOpen() const override;
+
+    const SANE_Option_Descriptor* optionDescriptor(SANE_Int option) override;
+    SANE_Status controlOption(SANE_Int option, SANE_Action action, void* value, SANE_Int* info) override;
+
+    SANE_Status start() override;
+    SANE_Status getParameters(SANE_Parameters* params) override;
+    SANE_Status read(SANE_Byte* data, SANE_Int maxLength, SANE_Int* length) override;
+    void cancel() override;
+
+    // libsane is initialized once per process and shared by all devices.
+    // exitBackend() must only be called while no device is open.
+    static bool initBackend();
+    static void exitBackend();
+
+private:
+    std::atomic<SANE_Handle> m_handle;
+    // Held by close() and cancel(), which run on different threads, so the
+    // handle is never closed while sane_cancel() is using it
+    std::mutex m_handleMutex;
+};
+
+#endif // SANESCANDEVICE_H
@@ -0,0 +1,69 @@
+#ifndef SCANBATCH_H
+#define SCANBATCH_H
+
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <algorithm>
+#include <memory>
+#include "MediaProfile.h"
+#include "ScanLineSink.h"
+
+// Pages of one batch scan, shared by every scanner that takes part in it.
+// An idle scanner claims the next page; a page that could not be scanned is
+// handed back so another scanner can pick it up. Thread-safe.
+class ScanBatch {
+public:
+    // detectFrom, if set, lets a preview pick the profile per scanner
+    ScanBatch(int pageCount, const QList<std::shared_ptr<ScanLineSink>>& sinks,
+              const MediaProfile& profile, const MediaProfileRegistry* detectFrom = nullptr)
+        : m_pageCount(pageCount)
+        , m_nextPage(0)
+        , m_sinks(sinks)
+        , m_profile(profile)
+        , m_detectFrom(detectFrom)
+    {
+    }
+
+    int pageCount() const { return m_pageCount; }
+    const MediaProfile& profile() const { return m_profile; }
+    const MediaProfileRegistry* detectFrom() const { return m_detectFrom; }
+
+    // Next page to scan, or -1 when every page has been claimed
+    int claimPage() {
+        QMutexLocker locker(&m_mutex);
+        if (!m_returnedPages.isEmpty()) {
+            auto lowest = std::min_element(m_returnedPages.begin(), m_returnedPages.end());
+            const int page = *lowest;
+            m_returnedPages.erase(lowest);
+            return page;
+        }
+        return m_nextPage < m_pageCount ? m_nextPage++ : -1;
+    }
+
+    void returnPage(int page) {
+        QMutexLocker locker(&m_mutex);
+        m_returnedPages.append(page);
+    }
+
+    bool hasPendingPages() const {
+        QMutexLocker locker(&m_mutex);
+        return !m_returnedPages.isEmpty() || m_nextPage < m_pageCount;
+    }
+
+    // Streaming sink for a page, if any
+    ScanLineSink* sink(int page) const {
+        return page < m_sinks.size() ? m_sinks[page].get() : nullptr;
+    }
+
+private:
+    mutable QMutex m_mutex;
+    const int m_pageCount;
+    int m_nextPage;
+    QList<int> m_returnedPages;
+    const QList<std::shared_ptr<ScanLineSink>> m_sinks;
+    const MediaProfile m_profile;
+    const MediaProfileRegistry* const m_detectFrom;
+};
+
+#endif // SCANBATCH_H
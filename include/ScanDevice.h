@@ -0,0 +1,33 @@
+#ifndef SCANDEVICE_H
+#define SCANDEVICE_H
+
+#include <QString>
+#include <sane/sane.h>
+
+// Frame format the fujitsu backend uses for scanner-side JPEG; not part of
+// the SANE standard. The data is a complete JFIF file.
+constexpr SANE_Frame kSaneFrameJpeg = static_cast<SANE_Frame>(11);
+
+// One scanner as seen by ScannerManager. The calls mirror the SANE API so
+// real and simulated devices go through exactly the same capture code.
+// Everything except cancel() is called on the scanner thread only.
+class ScanDevice {
+public:
+    virtual ~ScanDevice() = default;
+
+    virtual SANE_Status open(const QString& deviceName) = 0;
+    virtual void close() = 0;
+    virtual bool isOpen() const = 0;
+
+    virtual const SANE_Option_Descriptor* optionDescriptor(SANE_Int option) = 0;
+    virtual SANE_Status controlOption(SANE_Int option, SANE_Action action, void* value, SANE_Int* info) = 0;
+
+    virtual SANE_Status start() = 0;
+    virtual SANE_Status getParameters(SANE_Parameters* params) = 0;
+    virtual SANE_Status read(SANE_Byte* data, SANE_Int maxLength, SANE_Int* length) = 0;
+
+    // Safe to call from any thread to abort a blocking read()
+    virtual void cancel() = 0;
+};
+
+#endif // SCANDEVICE_H
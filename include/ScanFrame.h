@@ -0,0 +1,29 @@
+#ifndef SCANFRAME_H
+#define SCANFRAME_H
+
+#include <QMetaType>
+#include <QString>
+#include <QByteArray>
+#include <opencv2/core.hpp>
+
+// One captured page, held in memory and handed from the scanner to image processing
+struct ScanFrame {
+    cv::Mat image;  // BGR (CV_8UC3) or grayscale (CV_8UC1)
+    int dpi;
+    int page;       // index within a batch scan, 0 for single scans
+    int side;       // 0 front, 1 back of a duplex scan
+    QString profile;   // id of the media profile it was scanned with
+    QString spillPath; // set instead of image when the page was spilled to disk
+    QByteArray jpeg;   // set instead of image when the scanner compressed the page
+
+    ScanFrame() : dpi(0), page(0), side(0) {}
+
+    bool isEmpty() const { return image.empty() && spillPath.isEmpty() && jpeg.isEmpty(); }
+    bool isJpeg() const { return !jpeg.isEmpty(); }
+    bool isSpilled() const { return !spillPath.isEmpty(); }
+    bool isBack() const { return side == 1; }
+};
+
+Q_DECLARE_METATYPE(ScanFrame)
+
+#endif // SCANFRAME_H
@@ -0,0 +1,21 @@
+#ifndef SCANLINESINK_H
+#define SCANLINESINK_H
+
+#include <opencv2/core.hpp>
+
+// Receives scanlines while a page is still feeding.
+// All calls are made on the scanner thread and must return quickly.
+class ScanLineSink {
+public:
+    virtual ~ScanLineSink() = default;
+
+    virtual void beginPage(int width, int channels, int dpi) = 0;
+
+    // Complete rows in scan order (BGR or grayscale). The data stays valid
+    // and unmodified for the lifetime of the page.
+    virtual void addRows(const cv::Mat& rows) = 0;
+
+    virtual void endPage(bool completed) = 0;
+};
+
+#endif // SCANLINESINK_H
@@ -0,0 +1,89 @@
+#ifndef SCANPIPELINE_H
+#define SCANPIPELINE_H
+
+#include <QString>
+#include <QList>
+#include <QVector>
+#include <QByteArray>
+#include <QRect>
+#include <QThreadPool>
+#include <memory>
+#include <vector>
+#include "AppSettings.h"
+#include "AutoCrop.h"
+#include "JpegStripeEncoder.h"
+#include "ScanLineSink.h"
+
+// Streaming scan-to-JPEG pipeline.
+//
+// Bands of scanlines are analysed while the page is still feeding: each band
+// is added to a downsampled gray preview and to the same row/column darkness
+// profiles AutoCrop uses. Once the photo's columns are known, rows that lie
+// between confirmed content are cropped and JPEG-encoded stripe by stripe,
+// so only the bottom edge is left to do when the last line arrives.
+class ScanPipeline : public ScanLineSink {
+public:
+    explicit ScanPipeline(AppSettings* settings);
+    ~ScanPipeline() override;
+
+    void beginPage(int width, int channels, int dpi) override;
+    void addRows(const cv::Mat& rows) override;
+    void endPage(bool completed) override;
+
+    // Waits for queued bands, encodes the remaining rows and writes the JPEG.
+    // Returns false if the streamed result is unusable; the caller should then
+    // process the full frame instead.
+    bool finish(const QString& outputPath);
+
+    // Crop of the page written by finish(), and whether it was saved in gray
+    QRect cropRect() const { return m_cropRect; }
+    bool isGrayscale() const { return m_grayscale; }
+
+private:
+    struct Band {
+        int firstRow;
+        cv::Mat rows;
+    };
+
+    void resetPage(int width, int channels, int dpi);
+    void processBand(const cv::Mat& rows);
+    void lockColumns();
+    void checkColumns();
+    bool encodeRows(int endRow, bool flush);
+    cv::Mat copyRows(int firstRow, int lastRow) const;
+    bool matchesPreview(const QRect& cropRect);
+
+    AppSettings* m_settings;
+    QThreadPool m_pool;   // single thread, bands are processed in order
+    AutoCrop m_autoCrop;
+
+    // Page geometry
+    int m_width;
+    int m_channels;
+    int m_dpi;
+    int m_rowCount;
+    bool m_pageComplete;
+    bool m_valid;
+    QVector<Band> m_bands;
+    std::vector<cv::Mat> m_previewBands;
+
+    // Content profiles
+    int m_contentRows;
+    int m_topRow;
+    int m_lastContentRow;
+    bool m_colourSeen;     // some band had colour in it
+    bool m_grayscale;      // colour page encoded as one channel
+    std::vector<int> m_columnCounts;
+    std::vector<int> m_lockedCounts;
+
+    // Crop columns [m_left, m_right) and stripe encoding state
+    int m_left;
+    int m_right;
+    int m_encodeStartRow;
+    int m_nextEncodeRow;
+    std::unique_ptr<JpegStripeEncoder> m_encoder;
+    QList<QByteArray> m_stripes;
+    QRect m_cropRect;
+};
+
+#endif // SCANPIPELINE_H
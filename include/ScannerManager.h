@@ -3,9 +3,24 @@
 
 #include <QObject>
 #include <QString>
-#include <QProcess>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+#include <QList>
+#include <QSet>
+#include <QVector>
+#include <memory>
 #include "AppSettings.h"
+#include "MediaProfile.h"
+#include "ScanBatch.h"
+#include "ScanFrame.h"
+#include "ScanLineSink.h"
+#include "ScannerWorker.h"
+#include "UsbHotplugMonitor.h"
 
+// Pool of scanners. Every connected fi-800R (up to maxScanners) gets its own
+// worker; the pages of a batch are handed to whichever scanner is idle, so
+// several strips can feed at the same time.
 class ScannerManager : public QObject {
     Q_OBJECT
 
@@ -13,26 +28,83 @@ public:
     explicit ScannerManager(AppSettings* settings, QObject* parent = nullptr);
     ~ScannerManager();
 
-    bool detectScanner();
-    bool performScan(const QString& outputPath);
+    // Starts discovery in the background; the result arrives through
+    // scannerDetected()/scannerNotFound(), and again after USB hotplug events
+    void detectScanner();
+    bool performScan(std::shared_ptr<ScanLineSink> sink = nullptr);
+    // Scans pageCount pages on all scanners; sinks[i] receives page i
+    bool performBatchScan(int pageCount, const QList<std::shared_ptr<ScanLineSink>>& sinks = {});
+    void cancelScan();
+    // Profile id for the next scans, or MediaProfileRegistry::AutoDetect
+    bool setMediaProfile(const QString& profileId);
+    QString mediaProfile() const { return m_mediaProfile; }
+    // Auto-detection needs the flatbed preview; false on feeder sources
+    bool canDetectMedia() const;
+    const MediaProfileRegistry& mediaProfiles() const { return m_profiles; }
+    // Opens and configures the devices in the background ahead of a scan
+    void warmUp();
+    bool isScanning() const;
     bool isAvailable() const;
     QString getDeviceName() const;
-    QStringList listAvailableScanners();
+    int scannerCount() const;
+    QStringList listAvailableScanners() const;
 
 signals:
     void scannerDetected(const QString& deviceName);
     void scannerNotFound();
     void scanStarted();
+    void documentMissing();    // every scanner of the batch waits for a page
+    void documentDetected();
     void scanProgress(int percentage);
-    void scanCompleted(const QString& filePath);
+    void scanCompleted(const ScanFrame& frame);   // once per page
+    // After the last page; errorMessage is why the batch stopped early, empty
+    // if every page went through
+    void batchFinished(int pagesScanned, const QString& errorMessage);
     void scanFailed(const QString& errorMessage);
 
 private:
     AppSettings* m_settings;
-    QString m_deviceName;
-    QProcess* m_scanProcess;
+    const MediaProfileRegistry m_profiles;
+    QString m_mediaProfile;
+    QStringList m_availableDevices;
+    QList<ScannerWorker*> m_workers;   // one per device in use
+    UsbHotplugMonitor* m_hotplugMonitor;
+    QTimer* m_rediscoveryTimer;
 
-    void createDemoScan(const QString& outputPath);
+    // Enumeration and the SANE library lifecycle. Discovery never overlaps
+    // a batch: it is deferred until the batch ends, and a batch requested
+    // during discovery starts once it completes.
+    QThreadPool m_discoveryPool;
+    bool m_discovering;
+    bool m_discoveryPending;
+    bool m_reinitializePending;
+
+    // Batch in progress
+    std::shared_ptr<ScanBatch> m_batch;
+    bool m_scanning;
+    bool m_batchQueued;
+    QSet<ScannerWorker*> m_batchWorkers;
+    QSet<ScannerWorker*> m_waitingWorkers;
+    bool m_documentMissing;
+    QVector<int> m_pageProgress;
+    int m_lastProgress;
+    int m_pagesScanned;
+    QString m_batchError;
+
+    void startDiscovery(bool reinitialize);
+    QStringList enumerateDevices(bool reinitialize);
+    void onDevicesDiscovered(const QStringList& devices);
+    QStringList selectDevices(const QStringList& devices) const;
+    void setDevices(const QStringList& deviceNames);
+    ScannerWorker* createWorker(const QString& deviceName);
+    void scheduleRediscovery();
+    MediaProfile currentProfile() const;
+
+    void dispatchBatch();
+    void finishBatch();
+    void onWorkerProgress(int page, int percentage);
+    void onWorkerFinished(ScannerWorker* worker, int pagesScanned, const QString& errorMessage);
+    void updateDocumentState();
 };
 
 #endif // SCANNERMANAGER_H
@@ -0,0 +1,103 @@
+#ifndef SCANNERWORKER_H
+#define SCANNERWORKER_H
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QVariant>
+#include <QThreadPool>
+#include <QFuture>
+#include <QTimer>
+#include <QRectF>
+#include <atomic>
+#include <memory>
+#include <sane/sane.h>
+#include "AppSettings.h"
+#include "AutoCrop.h"
+#include "MediaProfile.h"
+#include "ScanBatch.h"
+#include "ScanFrame.h"
+#include "SaneScanDevice.h"
+#include "SimulatedScanDevice.h"
+
+// One scanner of the pool. The device handle stays open between scans and
+// every call into it runs on the worker's own single scan thread, so several
+// scanners can feed at the same time.
+class ScannerWorker : public QObject {
+    Q_OBJECT
+
+public:
+    ScannerWorker(AppSettings* settings, const QString& deviceName, QObject* parent = nullptr);
+    ~ScannerWorker();
+
+    QString deviceName() const { return m_deviceName; }
+
+    // Opens the device in the background; deviceUnavailable() if that fails
+    void probe();
+    // Scans pages claimed from the batch until none are left
+    bool startBatch(std::shared_ptr<ScanBatch> batch);
+    void cancelScan();
+    // Opens and configures the device in the background ahead of a scan
+    void warmUp(const MediaProfile& profile);
+    // Closes the device on the scan thread and waits for it
+    void releaseDevice();
+    bool isScanning() const;
+
+signals:
+    void documentMissing();    // armed, starts as soon as a page is inserted
+    void documentDetected();
+    void scanProgress(int page, int percentage);
+    void scanCompleted(const ScanFrame& frame);
+    void finished(int pagesScanned, const QString& errorMessage); // empty message on success
+    void deviceUnavailable();
+
+private:
+    AppSettings* m_settings;
+    const QString m_deviceName;
+    AutoCrop m_autoCrop;  // used on the scan thread for preview passes
+
+    // All SANE calls for this device run on the single thread of m_scanPool
+    QThreadPool m_scanPool;
+    QFuture<void> m_scanFuture;
+    QTimer* m_scanWatchdog;
+    SaneScanDevice m_saneDevice;
+    SimulatedScanDevice m_simulatedDevice;
+    ScanDevice* m_device;   // open device, scan thread only
+    QHash<QString, SANE_Int> m_optionIndex;
+    std::atomic<bool> m_scanning;
+    std::atomic<bool> m_cancelRequested;
+    std::atomic<bool> m_timedOut;
+    std::atomic<bool> m_warmingUp;
+    SANE_Status m_lastStatus;
+    int m_page;
+    int m_side;     // side being read, and sides per page (2 when duplex)
+    int m_sides;
+
+    void scanTask(std::shared_ptr<ScanBatch> batch);
+    void onScanTimeout();
+
+    bool openDevice(QString& errorMessage);
+    void closeDevice();
+    void loadOptionIndex();
+    bool setOption(const QString& name, const QVariant& value);
+    bool applyScanOptions(const MediaProfile& profile, QString& errorMessage);
+    bool optionRange(const QString& name, double& minValue, double& maxValue);
+    bool setScanArea(const QRectF& areaMm);
+    bool selectScanArea(MediaProfile& profile, const MediaProfileRegistry* detectFrom,
+                        QString& errorMessage);
+    QString scanSource() const;
+    bool isSheetFed() const;
+    bool readSensor(const QString& name, bool& value);
+    bool waitForDocument(const ScanBatch& batch, QString& errorMessage);
+    bool readFrame(ScanFrame& frame, int dpi, bool reportProgress, ScanLineSink* sink,
+                   QString& errorMessage);
+    bool readJpegFrame(const SANE_Parameters& params, ScanFrame& frame, int dpi, bool reportProgress,
+                       QString& errorMessage);
+    QString describeStatus(SANE_Status status) const;
+    bool isMemoryLow() const;
+    bool spillFrame(ScanFrame& frame);
+
+    ScanFrame createDemoScan(int side);
+};
+
+#endif // SCANNERWORKER_H
@@ -0,0 +1,84 @@
+#ifndef SIMULATEDSCANDEVICE_H
+#define SIMULATEDSCANDEVICE_H
+
+#include <QElapsedTimer>
+#include <QString>
+#include <atomic>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "AppSettings.h"
+#include "ScanDevice.h"
+
+// Software stand-in for the fi-800R used to benchmark the capture path on
+// machines without a scanner. It exposes the same SANE options as the real
+// device and delivers a synthetic photo strip at the configured line rate,
+// with feed latency, jitter, and optional paper jams and stalled transfers.
+class SimulatedScanDevice : public ScanDevice {
+public:
+    static const char* const DeviceName;
+    // Name of the index-th simulated scanner; the first one is DeviceName
+    static QString deviceName(int index);
+    static bool isSimulated(const QString& deviceName);
+
+    explicit SimulatedScanDevice(AppSettings* settings);
+    ~SimulatedScanDevice() override;
+
+    SANE_Status open(const QString& deviceName) override;
+    void close() override;
+    bool isOpen() const override;
+
+    const SANE_Option_Descriptor* optionDescriptor(SANE_Int option) override;
+    SANE_Status controlOption(SANE_Int option, SANE_Action action, void* value, SANE_Int* info) override;
+
+    SANE_Status start() override;
+    SANE_Status getParameters(SANE_Parameters* params) override;
+    SANE_Status read(SANE_Byte* data, SANE_Int maxLength, SANE_Int* length) override;
+    void cancel() override;
+
+private:
+    enum Option {
+        OptionCount = 0,
+        OptionSource,
+        OptionMode,
+        OptionResolution,
+        OptionTopLeftX,
+        OptionTopLeftY,
+        OptionBottomRightX,
+        OptionBottomRightY,
+        OptionPageLoaded,
+        OptionTotal
+    };
+
+    void setupOptions();
+    bool isSheetFed() const;
+    bool isDuplex() const;
+    void renderPage();
+    bool waitFor(int milliseconds);
+    int jittered(int milliseconds) const;
+
+    AppSettings* m_settings;
+    bool m_open;
+    std::atomic<bool> m_cancelled;
+    std::vector<SANE_Option_Descriptor> m_options;
+
+    // Option values
+    QString m_source;
+    QString m_mode;
+    SANE_Int m_resolution;
+    SANE_Fixed m_geometry[4]; // tl-x, tl-y, br-x, br-y
+
+    // Current page
+    bool m_batchActive;
+    int m_pagesLeft;
+    bool m_backPending;       // duplex: the next cycle returns the back side
+    cv::Mat m_page;           // full page, RGB, at m_pageDpi
+    cv::Mat m_backPage;       // back of the page, same size
+    int m_pageDpi;
+    cv::Mat m_scan;           // scanned area in SANE byte layout
+    SANE_Parameters m_params;
+    size_t m_bytesRead;
+    size_t m_jamOffset;       // SIZE_MAX when the page feeds normally
+    size_t m_stallOffset;
+};
+
+#endif // SIMULATEDSCANDEVICE_H
@@ -0,0 +1,9 @@
+#ifndef SYSTEMMEMORY_H
+#define SYSTEMMEMORY_H
+
+#include <QtGlobal>
+
+// MemAvailable from /proc/meminfo, or -1 where it is not available
+qint64 availableMemoryBytes();
+
+#endif // SYSTEMMEMORY_H
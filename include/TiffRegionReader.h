@@ -0,0 +1,56 @@
+#ifndef TIFFREGIONREADER_H
+#define TIFFREGIONREADER_H
+
+#include <QString>
+#include <QRect>
+#include <QSize>
+#include <QPoint>
+#include <QVector>
+#include <QThreadPool>
+#include <functional>
+#include <opencv2/core.hpp>
+#include <tiffio.h>
+
+// Reads parts of a TIFF file without decoding all of it.
+//
+// Strips (or tiles) are the unit of decoding: a downsampled preview only
+// decodes the strips holding its sample rows, a region only the strips or
+// tiles it intersects. Blocks are decoded several at a time on the given
+// pool, each thread with its own libtiff handle. Supports 8-bit gray and RGB images with
+// contiguous samples, which is what the scan spill writes; anything else
+// is left to cv::imread.
+class TiffRegionReader {
+public:
+    explicit TiffRegionReader(QThreadPool* pool = QThreadPool::globalInstance());
+    ~TiffRegionReader();
+
+    bool open(const QString& path);
+    void close();
+
+    QSize size() const { return QSize(m_width, m_height); }
+
+    // Every scale-th row, averaged down to 1/scale of the width (BGR or gray)
+    bool readPreview(int scale, cv::Mat& preview);
+    // Pixels of rect clipped to the image, BGR or gray like cv::imread
+    bool readRegion(const QRect& rect, cv::Mat& region);
+
+private:
+    QThreadPool* m_pool;
+    QString m_path;
+    TIFF* m_tiff;
+    int m_width;
+    int m_height;
+    int m_channels;
+    bool m_tiled;
+    int m_blockWidth;   // tile size, or the image width and rows per strip
+    int m_blockHeight;
+    tmsize_t m_blockBytes;
+
+    // Decodes the blocks (column, row of the block grid) in parallel and hands
+    // each one to consume, which may run on any thread
+    bool decodeBlocks(const QVector<QPoint>& blocks,
+                      const std::function<void(const QPoint& block, const uchar* data)>& consume) const;
+    QRect blockRect(const QPoint& block) const;
+};
+
+#endif // TIFFREGIONREADER_H
@@ -0,0 +1,32 @@
+#ifndef USBHOTPLUGMONITOR_H
+#define USBHOTPLUGMONITOR_H
+
+#include <QObject>
+#include <QString>
+
+class QSocketNotifier;
+
+// Listens for kernel USB hotplug events (the netlink uevents udev consumes)
+// so a scanner that is plugged in or reconnected is noticed without polling.
+class UsbHotplugMonitor : public QObject {
+    Q_OBJECT
+
+public:
+    explicit UsbHotplugMonitor(QObject* parent = nullptr);
+    ~UsbHotplugMonitor();
+
+    bool start();
+    bool isRunning() const;
+
+signals:
+    // action is "add" or "remove"; product is the uevent PRODUCT value (vid/pid/bcd)
+    void usbDeviceChanged(const QString& action, const QString& product);
+
+private:
+    void onReadable();
+
+    int m_socket;
+    QSocketNotifier* m_notifier;
+};
+
+#endif // USBHOTPLUGMONITOR_H
@@ -106,9 +106,19 @@ Window {
         ScanPromptScreen {
             totalScans: appController.credits
             currentScan: appController.currentScan
+            isScanning: appController.isScanning
+            processingCount: appController.processingCount
+            scanProgress: appController.scanProgress
+            waitingForDocument: appController.waitingForDocument
+            scanError: appController.scanError
+            mediaProfiles: appController.mediaProfiles
+            mediaProfile: appController.mediaProfile
             onScanRequested: {
                 appController.executeScan()
             }
+            onMediaProfileSelected: function(id) {
+                appController.setMediaProfile(id)
+            }
         }
     }
 
@@ -131,5 +141,10 @@ Window {
         function onScanningCompleted() {
             stackView.push(confirmationScreen)
         }
+
+        // A running scan counts as activity so the session is not reset mid-scan
+        function onScanProgressChanged() {
+            inactivityTimer.restart()
+        }
     }
 }
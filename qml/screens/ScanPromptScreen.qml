@@ -7,8 +7,15 @@ Item {
     property int totalScans: 1
     property int currentScan: 0
     property bool isScanning: false
+    property int processingCount: 0    // earlier strips still being processed
+    property int scanProgress: 0
+    property bool waitingForDocument: false
+    property string scanError: ""      // why the last scan stopped early
+    property var mediaProfiles: []
+    property string mediaProfile: ""
 
     signal scanRequested()
+    signal mediaProfileSelected(string id)
 
     Rectangle {
         anchors.fill: parent
@@ -23,7 +30,7 @@ Item {
             width: Math.min(root.width * 0.85, 500)
 
             Text {
-                text: isScanning ? "Scanning..." : (currentScan === 0 ? "Ready to Scan" : "Next Scan Ready")
+                text: waitingForDocument ? "Insert Your Strip" : (isScanning ? "Scanning... " + scanProgress + "%" : (currentScan >= totalScans ? "Finishing Your Photos" : (currentScan === 0 ? "Ready to Scan" : "Next Scan Ready")))
                 font.pixelSize: Math.min(root.width * 0.045, 32)
                 font.weight: Font.Bold
                 color: "white"
@@ -31,7 +38,7 @@ Item {
             }
 
             Text {
-                text: "Scanning " + (currentScan + 1) + " of " + totalScans
+                text: currentScan >= totalScans ? "All " + totalScans + " scanned" : "Scanning " + (currentScan + 1) + " of " + totalScans
                 font.pixelSize: Math.min(root.width * 0.032, 24)
                 font.weight: Font.SemiBold
                 color: "#E6FFFFFF"
@@ -135,13 +142,47 @@ Item {
                 anchors.horizontalCenter: parent.horizontalCenter
             }
 
+            // Media type selector
+            Row {
+                spacing: 8
+                visible: !isScanning && mediaProfiles.length > 1
+                anchors.horizontalCenter: parent.horizontalCenter
+
+                Repeater {
+                    model: mediaProfiles
+                    Button {
+                        property bool selected: modelData.id === mediaProfile
+                        height: Math.min(root.height * 0.07, 40)
+                        text: modelData.name
+                        font.pixelSize: Math.min(root.width * 0.018, 13)
+                        font.weight: Font.SemiBold
+
+                        background: Rectangle {
+                            color: parent.selected ? "white" : (parent.pressed ? "#4DFFFFFF" : "#26FFFFFF")
+                            radius: 8
+                        }
+
+                        contentItem: Text {
+                            text: parent.text
+                            font: parent.font
+                            color: parent.selected ? "#2563EB" : "white"
+                            horizontalAlignment: Text.AlignHCenter
+                            verticalAlignment: Text.AlignVCenter
+                        }
+
+                        onClicked: root.mediaProfileSelected(modelData.id)
+                    }
+                }
+            }
+
             Button {
                 width: parent.width
                 height: Math.min(root.height * 0.13, 70)
-                text: isScanning ? "Scanning..." : (currentScan === 0 ? "Start Scanning" : "Scan Next")
+                text: waitingForDocument ? "Waiting for strip..." : (isScanning ? "Scanning..." : (currentScan >= totalScans ? "Processing..." : (currentScan === 0 ? "Start Scanning" : "Scan Next")))
                 font.pixelSize: Math.min(root.width * 0.032, 24)
                 font.weight: Font.Bold
-                enabled: !isScanning
+                // Earlier strips keep processing in the background
+                enabled: !isScanning && currentScan < totalScans
                 anchors.horizontalCenter: parent.horizontalCenter
 
                 background: Rectangle {
@@ -166,6 +207,25 @@ Item {
                 color: "#CCFFFFFF"
                 anchors.horizontalCenter: parent.horizontalCenter
             }
+
+            Text {
+                text: scanError
+                visible: scanError !== "" && !isScanning
+                width: parent.width
+                wrapMode: Text.WordWrap
+                horizontalAlignment: Text.AlignHCenter
+                font.pixelSize: Math.min(root.width * 0.02, 14)
+                font.weight: Font.SemiBold
+                color: "#FECACA"
+            }
+
+            Text {
+                text: processingCount + (processingCount === 1 ? " photo processing" : " photos processing")
+                visible: processingCount > 0
+                font.pixelSize: Math.min(root.width * 0.016, 12)
+                color: "#CCFFFFFF"
+                anchors.horizontalCenter: parent.horizontalCenter
+            }
         }
 
         // Scanning animation
@@ -4,6 +4,8 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QDebug>
+#include <QVariantMap>
+#include <algorithm>
 
 AppController::AppController(AppSettings* settings, QObject* parent)
     : QObject(parent)
@@ -12,6 +14,9 @@ AppController::AppController(AppSettings* settings, QObject* parent)
     , m_price(0)
     , m_currentScan(0)
     , m_isScanning(false)
+    , m_scanProgress(0)
+    , m_waitingForDocument(false)
+    , m_stripCount(0)
 {
     // Create managers
     m_scanner = new ScannerManager(settings, this);
@@ -31,8 +36,16 @@ void AppController::connectSignals() {
             this, &AppController::onScannerDetected);
     connect(m_scanner, &ScannerManager::scannerNotFound,
             this, &AppController::onScannerNotFound);
+    connect(m_scanner, &ScannerManager::scanProgress,
+            this, &AppController::onScanProgress);
+    connect(m_scanner, &ScannerManager::documentMissing,
+            this, &AppController::onDocumentMissing);
+    connect(m_scanner, &ScannerManager::documentDetected,
+            this, &AppController::onDocumentDetected);
     connect(m_scanner, &ScannerManager::scanCompleted,
             this, &AppController::onScanCompleted);
+    connect(m_scanner, &ScannerManager::batchFinished,
+            this, &AppController::onBatchFinished);
     connect(m_scanner, &ScannerManager::scanFailed,
             this, &AppController::onScanFailed);
 
@@ -62,23 +75,24 @@ void AppController::connectSignals() {
 void AppController::initialize() {
     qInfo() << "Initializing application...";
 
-    // Detect scanner
-    if (m_scanner->detectScanner()) {
-        qInfo() << "Scanner ready!";
-    } else {
-        qWarning() << "Scanner not detected";
-        if (!m_settings->demoMode) {
-            qWarning() << "Please connect the Fujitsu fi-800R and restart, or run in demo mode";
-        }
-    }
+    // Detect scanner in the background so the UI comes up immediately
+    m_scanner->detectScanner();
 }
 
 void AppController::startNewSession() {
     qInfo() << "Starting new session";
     m_sessionId = QUuid::createUuid().toString(QUuid::WithoutBraces);
     m_scanPaths.clear();
+    m_pendingJobs.clear();
+    emit processingCountChanged();
+    m_stripCount = 0;
+    m_failedStrips.clear();
+    m_imageProcessor->setSessionId(m_sessionId);
     m_currentScan = 0;
     emit currentScanChanged();
+
+    // Wake the scanner while the customer is on the payment screens
+    m_scanner->warmUp();
 }
 
 void AppController::setPhoneNumber(const QString& phone) {
@@ -100,6 +114,9 @@ void AppController::setPurchaseInfo(int credits, int price) {
     }
     qInfo() << "Purchase info set:" << credits << "credits for $" << price;
 
+    // Keep the scanner ready in case it went back to sleep
+    m_scanner->warmUp();
+
     // In real implementation, create payment link here
     if (!m_settings->demoMode) {
         m_payment->createPaymentLink(credits, m_phoneNumber);
@@ -125,78 +142,283 @@ void AppController::performNextScan() {
 }
 
 void AppController::executeScan() {
-    qInfo() << "Executing scan" << (m_currentScan + 1);
+    // Earlier strips may still be processing; only the scanner has to be free
+    if (m_scanner->isScanning() || m_currentScan >= m_credits) {
+        qWarning() << "Scan requested while the scanner is busy or no credits are left";
+        return;
+    }
+
+    // In batch mode all remaining strips are fed in one go
+    const int pageCount = m_settings->batchScan ? std::max(1, m_credits - m_currentScan) : 1;
+    qInfo() << "Executing scan" << (m_currentScan + 1) << "-" << pageCount << "page(s)";
 
     m_isScanning = true;
     emit isScanningChanged();
+    setScanError(QString());
+
+    // Crop and encode while each page is still feeding
+    m_batchStrips.clear();
+    m_batchSessionId = m_sessionId;
+    m_pagePipelines.clear();
+    QList<std::shared_ptr<ScanLineSink>> sinks;
+    if (m_settings->streamingPipeline) {
+        for (int i = 0; i < pageCount; i++) {
+            m_pagePipelines.append(std::make_shared<ScanPipeline>(m_settings));
+            sinks.append(m_pagePipelines.last());
+        }
+    }
 
-    // Create temporary scan file (TIFF format)
-    QString scanFilename = QString("%1_scan_%2.tiff")
-                              .arg(m_sessionId)
-                              .arg(m_currentScan + 1);
-    QString scanPath = m_settings->scansDir.filePath(scanFilename);
-
-    // Perform scan
-    if (!m_scanner->performScan(scanPath)) {
+    // Start scan on the scanner thread (image data is captured in memory);
+    // each page is reported through onScanCompleted, errors through onScanFailed
+    if (!m_scanner->performBatchScan(pageCount, sinks)) {
         qCritical() << "Scan failed";
         m_isScanning = false;
         emit isScanningChanged();
     }
 }
 
+QString AppController::mediaProfile() const {
+    return m_scanner->mediaProfile();
+}
+
+QVariantList AppController::mediaProfiles() const {
+    QVariantList list;
+    if (m_scanner->canDetectMedia()) {
+        list.append(QVariantMap{{"id", MediaProfileRegistry::AutoDetect}, {"name", tr("Auto")}});
+    }
+    for (const MediaProfile& profile : m_scanner->mediaProfiles().profiles()) {
+        list.append(QVariantMap{{"id", profile.id}, {"name", profile.name}});
+    }
+    return list;
+}
+
+void AppController::setMediaProfile(const QString& profileId) {
+    if (profileId == m_scanner->mediaProfile()) {
+        return;
+    }
+    if (m_scanner->setMediaProfile(profileId)) {
+        qInfo() << "Media profile:" << profileId;
+        emit mediaProfileChanged();
+    }
+}
+
 void AppController::onScannerDetected(const QString& deviceName) {
-    qInfo() << "Scanner detected:" << deviceName;
+    qInfo() << "Scanner ready:" << deviceName;
 }
 
 void AppController::onScannerNotFound() {
-    qWarning() << "Scanner not found";
+    qWarning() << "Scanner not detected";
+    qWarning() << "Please connect the Fujitsu fi-800R (it is picked up automatically), or run in demo mode";
+}
+
+void AppController::onScanProgress(int percentage) {
+    if (m_scanProgress != percentage) {
+        m_scanProgress = percentage;
+        emit scanProgressChanged();
+    }
+}
+
+void AppController::onDocumentMissing() {
+    qInfo() << "Waiting for the customer to insert a strip";
+    setWaitingForDocument(true);
+}
+
+void AppController::onDocumentDetected() {
+    setWaitingForDocument(false);
+}
+
+void AppController::setWaitingForDocument(bool waiting) {
+    if (m_waitingForDocument != waiting) {
+        m_waitingForDocument = waiting;
+        emit waitingForDocumentChanged();
+    }
 }
 
-void AppController::onScanCompleted(const QString& filePath) {
-    qInfo() << "Scan completed:" << filePath;
+void AppController::onScanCompleted(const ScanFrame& frame) {
+    qInfo() << "Scan completed:" << frame.image.cols << "x" << frame.image.rows;
+
+    // The session may have been cancelled while the scan was running, and a
+    // new one started before the scanner stopped
+    if (m_sessionId.isEmpty() || m_batchSessionId != m_sessionId) {
+        qInfo() << "Ignoring scan from a cancelled session";
+        if (frame.isSpilled()) {
+            QFile::remove(frame.spillPath);
+        }
+        return;
+    }
+
+    // A captured strip uses its credit right away, so the next one can be fed
+    // while this one is processed. The back follows the front of its page.
+    int strip;
+    if (frame.isBack()) {
+        strip = m_batchStrips.value(frame.page);
+    } else {
+        // Every capture gets a new number, also a strip fed again after a
+        // failure: the failed one's back side may still be processing
+        strip = ++m_stripCount;
+        m_batchStrips.insert(frame.page, strip);
+        m_currentScan++;
+        emit currentScanChanged();
+        if (m_currentScan < m_credits) {
+            qInfo() << "Strip" << strip << "scanned, ready for the next one while it is processed";
+        }
+    }
+
+    // Process image (crop and convert to JPEG); each side is its own job
+    QString outputPath = stripPath(strip, frame.isBack());
 
-    // Process image (crop and convert to JPEG)
-    QString outputFilename = QString("%1_strip_%2.jpg")
-                                .arg(m_sessionId)
-                                .arg(m_currentScan + 1);
-    QString outputPath = m_settings->scansDir.filePath(outputFilename);
+    std::shared_ptr<ScanPipeline> pipeline;
+    if (!frame.isBack() && frame.page < m_pagePipelines.size()) {
+        pipeline = m_pagePipelines[frame.page];
+        m_pagePipelines[frame.page].reset();
+    }
+
+    // Profiles with a fixed output size are scaled after the crop, which the
+    // streaming pipeline does not do
+    const MediaProfile profile = m_scanner->mediaProfiles().find(frame.profile);
+    m_imageProcessor->setOutputSize(profile.outputSize);
+    if (!profile.outputSize.isEmpty()) {
+        pipeline.reset();
+    }
+
+    int jobId;
+    if (frame.isJpeg()) {
+        jobId = m_imageProcessor->processJpeg(frame.jpeg, outputPath);
+    } else if (frame.isSpilled()) {
+        // Spilled under memory pressure; the temporary file is removed once read
+        jobId = m_imageProcessor->processImage(frame.spillPath, outputPath, true);
+    } else {
+        jobId = m_imageProcessor->processImage(frame.image, outputPath, pipeline);
+    }
+    m_pendingJobs.insert(jobId, StripJob{strip, frame.isBack()});
+    emit processingCountChanged();
+}
 
-    m_imageProcessor->processImage(filePath, outputPath);
+void AppController::onBatchFinished(int pagesScanned, const QString& errorMessage) {
+    qInfo() << "Scanner finished:" << pagesScanned << "page(s)";
+    // A jam or timeout after the first pages still has to reach the customer
+    setScanError(errorMessage);
+    m_pagePipelines.clear();
+    setWaitingForDocument(false);
+    updateScanningState();
+    sendEmailWhenComplete();
 }
 
 void AppController::onScanFailed(const QString& errorMessage) {
     qCritical() << "Scan failed:" << errorMessage;
-    m_isScanning = false;
-    emit isScanningChanged();
+    setScanError(errorMessage);
+    m_pagePipelines.clear();
+    setWaitingForDocument(false);
+    updateScanningState();
+    sendEmailWhenComplete();
+}
+
+void AppController::setScanError(const QString& errorMessage) {
+    // A cancelled batch of an earlier session reports after the reset; its
+    // error is not this customer's
+    if (!errorMessage.isEmpty() && (m_sessionId.isEmpty() || m_batchSessionId != m_sessionId)) {
+        return;
+    }
+    if (m_scanError != errorMessage) {
+        m_scanError = errorMessage;
+        emit scanErrorChanged();
+    }
+}
+
+void AppController::updateScanningState() {
+    // Busy while the scanner is; processing carries on in the background
+    bool scanning = m_scanner->isScanning();
+    if (m_isScanning != scanning) {
+        m_isScanning = scanning;
+        emit isScanningChanged();
+    }
 }
 
-void AppController::onProcessingCompleted(const QString& outputPath) {
-    qInfo() << "Processing completed:" << outputPath;
+void AppController::onProcessingCompleted(int jobId, const QString& outputPath, const QStringList& framePaths) {
+    if (!m_pendingJobs.contains(jobId)) {
+        return;
+    }
+    const StripJob job = m_pendingJobs.take(jobId);
+    emit processingCountChanged();
+
+    // The back of a strip whose front failed is not delivered; the customer
+    // feeds that strip again
+    if (job.back && m_failedStrips.contains(job.strip)) {
+        qInfo() << "Dropping back side of failed strip" << job.strip;
+        QFile::remove(outputPath);
+        for (const QString& path : framePaths) {
+            QFile::remove(path);
+        }
+        sendEmailWhenComplete();
+        return;
+    }
+
+    qInfo() << "Processing completed: strip" << job.strip << (job.back ? "back" : "front") << outputPath;
     m_scanPaths.append(outputPath);
+    // The photos of a split strip are delivered next to the strip
+    m_scanPaths.append(framePaths);
 
-    // Remove temporary TIFF file
-    QString tiffPath = outputPath;
-    tiffPath.replace(".jpg", ".tiff");
-    QFile::remove(tiffPath);
+    sendEmailWhenComplete();
+}
 
-    m_isScanning = false;
-    emit isScanningChanged();
+void AppController::onProcessingFailed(int jobId, const QString& errorMessage) {
+    if (!m_pendingJobs.contains(jobId)) {
+        return;
+    }
+    const StripJob job = m_pendingJobs.take(jobId);
+    emit processingCountChanged();
 
-    m_currentScan++;
-    emit currentScanChanged();
+    qCritical() << "Processing failed: strip" << job.strip << (job.back ? "back" : "front") << errorMessage;
 
-    if (m_currentScan < m_credits) {
-        qInfo() << "Scan" << m_currentScan << "successful! Ready for next scan";
-    } else {
-        qInfo() << "All scans completed! Sending email...";
-        sendEmail();
+    // The credit of a front that could not be processed is given back, so the
+    // strip can be fed again; a failed back side is simply left out
+    if (!job.back && m_currentScan > 0) {
+        m_currentScan--;
+        emit currentScanChanged();
+        m_failedStrips.insert(job.strip);
+        dropBackSide(job.strip);
     }
+
+    sendEmailWhenComplete();
 }
 
-void AppController::onProcessingFailed(const QString& errorMessage) {
-    qCritical() << "Processing failed:" << errorMessage;
-    m_isScanning = false;
-    emit isScanningChanged();
+QString AppController::stripPath(int strip, bool back) const {
+    return m_settings->scansDir.filePath(QString("%1_strip_%2%3.jpg")
+                                             .arg(m_sessionId)
+                                             .arg(strip)
+                                             .arg(back ? "_back" : ""));
+}
+
+void AppController::dropBackSide(int strip) {
+    // The back may already be done, with the photos split from it
+    const QString backPath = stripPath(strip, true);
+    const QString photoPrefix = QFileInfo(backPath).completeBaseName() + "_photo_";
+    for (int i = m_scanPaths.size() - 1; i >= 0; --i) {
+        const QString& path = m_scanPaths[i];
+        if (path == backPath || QFileInfo(path).fileName().startsWith(photoPrefix)) {
+            QFile::remove(path);
+            m_scanPaths.removeAt(i);
+        }
+    }
+}
+
+void AppController::sendEmailWhenComplete() {
+    if (m_currentScan < m_credits) {
+        return;
+    }
+
+    // The last strip may still be feeding (or its back side), and earlier
+    // strips may still be processing
+    if (m_scanner->isScanning()) {
+        return;
+    }
+    if (!m_pendingJobs.isEmpty()) {
+        qInfo() << "All strips scanned, waiting for" << m_pendingJobs.size() << "more image(s)";
+        return;
+    }
+
+    qInfo() << "All scans completed! Sending email...";
+    sendEmail();
 }
 
 void AppController::sendEmail() {
@@ -302,9 +524,26 @@ void AppController::resetToIdle() {
         m_currentScan = 0;
         emit currentScanChanged();
     }
-    if (m_isScanning) {
-        m_isScanning = false;
-        emit isScanningChanged();
+    m_pagePipelines.clear();
+    // Queued pages of the session are dropped, running ones finish unreported
+    m_imageProcessor->cancelSession(m_sessionId);
+    if (!m_pendingJobs.isEmpty()) {
+        m_pendingJobs.clear();
+        emit processingCountChanged();
+    }
+    m_batchStrips.clear();
+    m_failedStrips.clear();
+    setWaitingForDocument(false);
+    setScanError(QString());
+    // isScanning stays set until the scanner has really stopped (batchFinished
+    // or scanFailed), so the next session cannot start a scan before that
+    if (m_scanner->isScanning()) {
+        m_scanner->cancelScan();
+    }
+    updateScanningState();
+    if (m_scanProgress != 0) {
+        m_scanProgress = 0;
+        emit scanProgressChanged();
     }
 
     m_sessionId.clear();
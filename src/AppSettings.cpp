@@ -9,7 +9,24 @@ AppSettings::AppSettings()
     , scannerDpi(600)
     , scannerMode("Color")
     , scannerFormat("tiff")
+    , scannerSource("Card Front")
+    , duplexScan(false)
+    , duplexSource("Card Duplex")
     , scannerDevice("") // Will be auto-detected
+    , scannerJpeg(false)
+    , maxScanners(2)
+    , previewScan(true)
+    , previewDpi(75)
+    , batchScan(true)
+    , mediaProfile("auto")
+    , simulatedScanner(false)
+    , simLinesPerSecond(1200)
+    , simStartLatencyMs(800)
+    , simJitterPercent(20)
+    , simJamPercent(0)
+    , simTimeoutPercent(0)
+    , simFeederPages(100)
+    , simScannerCount(1)
     , cropX1(0), cropY1(0), cropX2(1725), cropY2(1988)
     , scanTimeout(180)
     , paymentTimeout(300)
@@ -18,6 +35,14 @@ AppSettings::AppSettings()
     , squareApiVersion("2024-11-13")
     , jpegQuality(92)
     , cropDetectionThreshold(240)
+    , streamingPipeline(true)
+    , grayscaleDetection(true)
+    , splitFrames(true)
+    , deskew(true)
+    , spillThresholdMb(0)
+    , processingWorkers(2)
+    , processingMemoryMb(0)
+    , bufferPool(true)
     , windowWidth(1024)
     , windowHeight(768)
     , fullscreen(false)
@@ -67,6 +92,40 @@ void AppSettings::loadFromEnvironment() {
     squareLocationId = env.value("SQUARE_LOCATION_ID", "LNDWT6XQMEBYS");
     squareApiBase = env.value("SQUARE_API_BASE", "https://connect.squareupsandbox.com");
 
+    // Scanner settings
+    duplexScan = env.value("DUPLEX_SCAN", "false").toLower() == "true";
+    duplexSource = env.value("DUPLEX_SOURCE", "Card Duplex");
+    // Raw scanlines by default: they feed the streaming pipeline, which has
+    // the strip cropped and encoded by the time it leaves the feeder. A JPEG
+    // from the scanner arrives whole at the end of the page, so it can only
+    // be processed afterwards; it is worth it only where USB is the bottleneck.
+    scannerJpeg = env.value("SCANNER_JPEG", "false").toLower() == "true";
+    maxScanners = env.value("MAX_SCANNERS", "2").toInt();
+    previewScan = env.value("PREVIEW_SCAN", "true").toLower() == "true";
+    previewDpi = env.value("PREVIEW_DPI", "75").toInt();
+    batchScan = env.value("BATCH_SCAN", "true").toLower() == "true";
+    mediaProfile = env.value("MEDIA_PROFILE", "auto");
+
+    // Simulated scanner
+    simulatedScanner = env.value("SIM_SCANNER", "false").toLower() == "true";
+    simLinesPerSecond = env.value("SIM_LINES_PER_SEC", "1200").toInt();
+    simStartLatencyMs = env.value("SIM_LATENCY_MS", "800").toInt();
+    simJitterPercent = env.value("SIM_JITTER_PERCENT", "20").toInt();
+    simJamPercent = env.value("SIM_JAM_PERCENT", "0").toInt();
+    simTimeoutPercent = env.value("SIM_TIMEOUT_PERCENT", "0").toInt();
+    simFeederPages = env.value("SIM_FEEDER_PAGES", "100").toInt();
+    simScannerCount = env.value("SIM_SCANNERS", "1").toInt();
+
+    // Image processing
+    streamingPipeline = env.value("STREAMING_PIPELINE", "true").toLower() == "true";
+    grayscaleDetection = env.value("GRAYSCALE_DETECTION", "true").toLower() == "true";
+    splitFrames = env.value("SPLIT_FRAMES", "true").toLower() == "true";
+    deskew = env.value("DESKEW", "true").toLower() == "true";
+    spillThresholdMb = env.value("SPILL_THRESHOLD_MB", "0").toInt();
+    processingWorkers = env.value("PROCESSING_WORKERS", "2").toInt();
+    processingMemoryMb = env.value("PROCESSING_MEMORY_MB", "0").toInt();
+    bufferPool = env.value("BUFFER_POOL", "true").toLower() == "true";
+
     // UI settings
     fullscreen = env.value("KIOSK_FULLSCREEN", "false").toLower() == "true";
 
@@ -90,3 +149,16 @@ double AppSettings::getPriceDollars(int quantity) const {
 int AppSettings::getPriceCents(int quantity) const {
     return prices.value(quantity, 0);
 }
+
+QString AppSettings::scanSource() const {
+    return duplexScan ? duplexSource : scannerSource;
+}
+
+bool AppSettings::isSheetFed() const {
+    // A feeder ejects the card after one pass, so it cannot be scanned twice
+    const QString source = scanSource();
+    return source.contains("ADF", Qt::CaseInsensitive) ||
+           source.contains("Card", Qt::CaseInsensitive) ||
+           source.contains("Feeder", Qt::CaseInsensitive) ||
+           source.contains("Duplex", Qt::CaseInsensitive);
+}
@@ -1,6 +1,182 @@
 #include "AutoCrop.h"
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <opencv2/core/hal/intrin.hpp>
+
+namespace {
+// Long side of the copy analysed for colour; averaging also hides sensor
+// noise and the colour fringes scanners leave at sharp edges
+constexpr int kChromaSampleSize = 256;
+// Spread between the largest and smallest channel still counted as neutral
+constexpr int kChromaTolerance = 20;
+// Share of coloured pixels a black-and-white image may contain
+constexpr double kColourFraction = 0.01;
+
+// Largest downscaling of the coarse contour pass, and the smallest long side
+// the downscaled image may have
+constexpr int kPyramidScale = 8;
+constexpr int kCoarseMinSide = 200;
+// Pieces each side is refined in; the outermost one bounds a skewed photo
+constexpr int kEdgeSegments = 8;
+// Grey level difference needed to trust a refined edge
+constexpr double kMinEdgeContrast = 24.0;
+
+// Share of rows and columns inside the photo that must be mostly dark for
+// the profile detector to be trusted
+constexpr double kMinProfileConfidence = 0.6;
+// Frame splitting: most frames in a strip, smallest frame relative to the
+// largest, and the margin kept around each frame
+constexpr int kMaxFrames = 6;
+constexpr double kMinFrameRatio = 0.5;
+constexpr int kFrameMargin = 5;
+// Skew that is worth a warp, and the most that is trusted
+constexpr double kMinDeskewAngle = 0.3;
+constexpr double kMaxDeskewAngle = 10.0;
+// Points sampled along an edge to measure its skew
+constexpr int kSkewSamples = 64;
+// Rows after which the 16-bit column counters are flushed
+constexpr int kColumnFlushRows = 65535;
+
+// BT.601 luma weights in 14-bit fixed point, as cvtColor uses
+constexpr int kLumaB = 1868;
+constexpr int kLumaG = 9617;
+constexpr int kLumaR = 4899;
+constexpr int kLumaShift = 14;
+// 5-tap binomial kernel, the 5x5 Gaussian GaussianBlur picks for sigma 0
+constexpr int kBlurTaps[5] = {1, 4, 6, 4, 1};
+constexpr int kBlurRows = 5;
+
+inline int reflect101(int i, int size) {
+    return i < 0 ? -i : (i >= size ? 2 * size - 2 - i : i);
+}
+
+// Gray, area-downsampled by scale and 5x5 Gaussian-blurred in one sweep over
+// the source rows. Only the channel sums of one output row and the last five
+// horizontally blurred rows are kept, instead of full-size gray and blurred
+// copies. Empty if the layout is not supported or the result would be tiny.
+cv::Mat blurredGrayDownsample(const cv::Mat& image, int scale) {
+    const int channels = image.channels();
+    const int width = (image.cols + scale - 1) / scale;
+    const int height = (image.rows + scale - 1) / scale;
+    if (image.depth() != CV_8U || (channels != 1 && channels != 3) ||
+        width < kBlurRows || height < kBlurRows) {
+        return cv::Mat();
+    }
+
+    cv::Mat blurred(height, width, CV_8UC1);
+    std::vector<int> sums(static_cast<size_t>(width) * channels);
+    std::vector<int> gray(width);
+    std::vector<int> ring(static_cast<size_t>(width) * kBlurRows);
+
+    // Vertical pass for output row y; all five source rows are in the ring
+    auto emitRow = [&](int y) {
+        uchar* out = blurred.ptr<uchar>(y);
+        const int* taps[kBlurRows];
+        for (int k = 0; k < kBlurRows; k++) {
+            taps[k] = ring.data() + static_cast<size_t>(reflect101(y + k - 2, height) % kBlurRows) * width;
+        }
+        for (int x = 0; x < width; x++) {
+            const int value = taps[0][x] + 4 * taps[1][x] + 6 * taps[2][x] + 4 * taps[3][x] + taps[4][x];
+            out[x] = cv::saturate_cast<uchar>((value + 128) >> 8);
+        }
+    };
+
+    for (int cy = 0; cy < height; cy++) {
+        const int firstRow = cy * scale;
+        const int lastRow = std::min(image.rows, firstRow + scale);
+
+        // Channel sums of each scale x scale block
+        std::fill(sums.begin(), sums.end(), 0);
+        for (int y = firstRow; y < lastRow; y++) {
+            const uchar* pixel = image.ptr<uchar>(y);
+            int* sum = sums.data();
+            for (int x = 0; x < image.cols; sum += channels) {
+                const int blockEnd = std::min(image.cols, x + scale);
+                if (channels == 3) {
+                    for (; x < blockEnd; x++, pixel += 3) {
+                        sum[0] += pixel[0];
+                        sum[1] += pixel[1];
+                        sum[2] += pixel[2];
+                    }
+                } else {
+                    for (; x < blockEnd; x++, pixel++) {
+                        sum[0] += pixel[0];
+                    }
+                }
+            }
+        }
+
+        // Block average converted to gray, once per output pixel
+        for (int cx = 0; cx < width; cx++) {
+            const int count = (lastRow - firstRow) * (std::min(image.cols, (cx + 1) * scale) - cx * scale);
+            const int* sum = sums.data() + static_cast<size_t>(cx) * channels;
+            const int64_t luma = channels == 3
+                ? (static_cast<int64_t>(kLumaB) * sum[0] + static_cast<int64_t>(kLumaG) * sum[1] +
+                   static_cast<int64_t>(kLumaR) * sum[2])
+                : (static_cast<int64_t>(sum[0]) << kLumaShift);
+            gray[cx] = static_cast<int>((luma + (static_cast<int64_t>(count) << (kLumaShift - 1))) /
+                                        (static_cast<int64_t>(count) << kLumaShift));
+        }
+
+        // Horizontal pass into the ring
+        int* slot = ring.data() + static_cast<size_t>(cy % kBlurRows) * width;
+        for (int cx = 0; cx < width; cx++) {
+            int value = 0;
+            for (int k = 0; k < kBlurRows; k++) {
+                value += kBlurTaps[k] * gray[reflect101(cx + k - 2, width)];
+            }
+            slot[cx] = value;
+        }
+
+        // Row cy completes the window of row cy - 2
+        if (cy >= 2) {
+            emitRow(cy - 2);
+        }
+    }
+
+    // The last two rows reflect rows that are already in the ring
+    emitRow(height - 2);
+    emitRow(height - 1);
+    return blurred;
+}
+
+// Mean skew of the sides of a quad ordered top-left, top-right, bottom-right,
+// bottom-left, in degrees
+double quadAngle(const std::vector<cv::Point>& quad) {
+    const cv::Point& tl = quad[0];
+    const cv::Point& tr = quad[1];
+    const cv::Point& br = quad[2];
+    const cv::Point& bl = quad[3];
+
+    const double sum = std::atan2(tr.y - tl.y, tr.x - tl.x) + std::atan2(br.y - bl.y, br.x - bl.x) +
+                       std::atan2(tl.x - bl.x, bl.y - tl.y) + std::atan2(tr.x - br.x, br.y - tr.y);
+    return sum / 4.0 * 180.0 / CV_PI;
+}
+
+// Position of the step in a profile ordered from outside to inside, where it
+// crosses halfway between the outside and inside levels; -1 if there is none
+double stepPosition(const std::vector<double>& profile) {
+    const size_t n = profile.size();
+    if (n < 4) {
+        return -1.0;
+    }
+
+    const double outside = (profile[0] + profile[1]) / 2.0;
+    const double inside = (profile[n - 1] + profile[n - 2]) / 2.0;
+    if (std::abs(inside - outside) < kMinEdgeContrast) {
+        return -1.0;
+    }
+
+    const double mid = (outside + inside) / 2.0;
+    for (size_t i = 1; i < n; i++) {
+        if ((profile[i - 1] - mid) * (profile[i] - mid) <= 0.0 && profile[i - 1] != profile[i]) {
+            return (i - 1) + (profile[i - 1] - mid) / (profile[i - 1] - profile[i]);
+        }
+    }
+    return -1.0;
+}
+}
 
 AutoCrop::AutoCrop() {
 }
@@ -8,6 +184,70 @@ AutoCrop::AutoCrop() {
 AutoCrop::~AutoCrop() {
 }
 
+void AutoCrop::darknessProfiles(const cv::Mat& image, int threshold, std::vector<int>& rowCounts,
+                                std::vector<int>& columnCounts) {
+    const int width = image.cols;
+    const int channels = image.channels();
+    const uchar cutoff = cv::saturate_cast<uchar>(threshold);
+
+    rowCounts.assign(image.rows, 0);
+    columnCounts.assign(width, 0);
+    std::vector<ushort> columns(width, 0);
+    int pendingRows = 0;
+
+    for (int y = 0; y < image.rows; y++) {
+        const uchar* row = image.ptr<uchar>(y);
+        int x = 0;
+        int count = 0;
+
+#if CV_SIMD
+        const int lanes = cv::v_uint8::nlanes;
+        const cv::v_uint8 vCutoff = cv::v_setall_u8(cutoff);
+        const cv::v_uint8 vOne = cv::v_setall_u8(1);
+        cv::v_uint16 rowSum = cv::v_setzero_u16();
+
+        for (; x <= width - lanes; x += lanes) {
+            cv::v_uint8 darkest;
+            if (channels == 3) {
+                cv::v_uint8 b, g, r;
+                cv::v_load_deinterleave(row + 3 * x, b, g, r);
+                darkest = cv::v_min(b, cv::v_min(g, r));
+            } else {
+                darkest = cv::v_load(row + x);
+            }
+
+            const cv::v_uint8 dark = (darkest < vCutoff) & vOne;
+            cv::v_uint16 low, high;
+            cv::v_expand(dark, low, high);
+            rowSum += low + high;
+
+            ushort* counters = columns.data() + x;
+            cv::v_store(counters, cv::v_load(counters) + low);
+            cv::v_store(counters + lanes / 2, cv::v_load(counters + lanes / 2) + high);
+        }
+        count = static_cast<int>(cv::v_reduce_sum(rowSum));
+#endif
+
+        for (; x < width; x++) {
+            const uchar* pixel = row + x * channels;
+            const uchar darkest = channels == 3 ? std::min({pixel[0], pixel[1], pixel[2]}) : pixel[0];
+            if (darkest < cutoff) {
+                count++;
+                columns[x]++;
+            }
+        }
+
+        rowCounts[y] = count;
+        if (++pendingRows == kColumnFlushRows || y == image.rows - 1) {
+            for (int i = 0; i < width; i++) {
+                columnCounts[i] += columns[i];
+            }
+            std::fill(columns.begin(), columns.end(), 0);
+            pendingRows = 0;
+        }
+    }
+}
+
 AutoCrop::CropResult AutoCrop::detectPhotoBounds(const QString& imagePath, int threshold) {
     if (imagePath.isEmpty()) {
         qCritical() << "Auto-crop: Image path is empty";
@@ -47,31 +287,44 @@ AutoCrop::CropResult AutoCrop::detectPhotoBounds(const cv::Mat& image, int thres
     }
 
     try {
-        // Find the largest rectangle in the image
-        std::vector<cv::Point> corners = findLargestRectangle(image, threshold);
+        cv::Rect boundingRect;
+        double confidence = 0.0;
 
-        if (corners.empty()) {
-            qWarning() << "Auto-crop: No corners detected";
-            // Fallback: return the entire image bounds
-            return CropResult(QRect(0, 0, image.cols, image.rows));
-        }
+        double angle = 0.0;
 
-        if (corners.size() != 4) {
-            qWarning() << "Auto-crop: Could not detect 4 corners, found:" << corners.size();
-            // Fallback: return the entire image bounds
-            return CropResult(QRect(0, 0, image.cols, image.rows));
-        }
+        // A white background around the photo needs no more than the darkness profiles
+        if (findProfileBounds(image, threshold, boundingRect, confidence)) {
+            qInfo() << "Auto-crop: Profile detector bounds, confidence" << confidence;
+            angle = estimateSkew(image, boundingRect, threshold);
+        } else {
+            qInfo() << "Auto-crop: Profile confidence" << confidence << "too low, detecting contours";
 
-        // Order the corners
-        std::vector<cv::Point> orderedCorners = orderPoints(corners);
+            // Find the largest rectangle in the image
+            std::vector<cv::Point> corners = findPhotoCorners(image, threshold, angle);
 
-        if (orderedCorners.size() != 4) {
-            qWarning() << "Auto-crop: Point ordering failed";
-            return CropResult(QRect(0, 0, image.cols, image.rows));
-        }
+            if (corners.empty()) {
+                qWarning() << "Auto-crop: No corners detected";
+                // Fallback: return the entire image bounds
+                return CropResult(QRect(0, 0, image.cols, image.rows));
+            }
 
-        // Calculate bounding rectangle
-        cv::Rect boundingRect = cv::boundingRect(orderedCorners);
+            if (corners.size() != 4) {
+                qWarning() << "Auto-crop: Could not detect 4 corners, found:" << corners.size();
+                // Fallback: return the entire image bounds
+                return CropResult(QRect(0, 0, image.cols, image.rows));
+            }
+
+            // Order the corners
+            std::vector<cv::Point> orderedCorners = orderPoints(corners);
+
+            if (orderedCorners.size() != 4) {
+                qWarning() << "Auto-crop: Point ordering failed";
+                return CropResult(QRect(0, 0, image.cols, image.rows));
+            }
+
+            // Calculate bounding rectangle
+            boundingRect = cv::boundingRect(orderedCorners);
+        }
 
         // Validate bounding rectangle
         if (boundingRect.width <= 0 || boundingRect.height <= 0) {
@@ -99,8 +352,8 @@ AutoCrop::CropResult AutoCrop::detectPhotoBounds(const cv::Mat& image, int thres
         QRect cropRect(boundingRect.x, boundingRect.y, boundingRect.width, boundingRect.height);
 
         qInfo() << "Auto-crop detected bounds:" << cropRect
-                << "(" << (detectedArea / imageArea * 100) << "% of image)";
-        return CropResult(cropRect);
+                << "(" << (detectedArea / imageArea * 100) << "% of image), skew" << angle << "degrees";
+        return CropResult(cropRect, angle);
 
     } catch (const cv::Exception& e) {
         qCritical() << "Auto-crop: OpenCV exception:" << e.what();
@@ -114,6 +367,390 @@ AutoCrop::CropResult AutoCrop::detectPhotoBounds(const cv::Mat& image, int thres
     }
 }
 
+bool AutoCrop::findProfileBounds(const cv::Mat& image, int threshold, cv::Rect& bounds,
+                                 double& confidence) const {
+    confidence = 0.0;
+    if (image.depth() != CV_8U || (image.channels() != 1 && image.channels() != 3)) {
+        return false;
+    }
+
+    std::vector<int> rowCounts;
+    std::vector<int> columnCounts;
+    darknessProfiles(image, threshold, rowCounts, columnCounts);
+
+    // Specks of dust stay below these
+    const int minRowPixels = std::max(3, image.cols / 200);
+    const int minColumnPixels = std::max(3, image.rows / 200);
+
+    int top = -1, bottom = -1;
+    for (int y = 0; y < image.rows; y++) {
+        if (rowCounts[y] >= minRowPixels) {
+            if (top < 0) {
+                top = y;
+            }
+            bottom = y;
+        }
+    }
+
+    int left = -1, right = -1;
+    for (int x = 0; x < image.cols; x++) {
+        if (columnCounts[x] >= minColumnPixels) {
+            if (left < 0) {
+                left = x;
+            }
+            right = x;
+        }
+    }
+
+    if (top < 0 || left < 0) {
+        return false;
+    }
+    bounds = cv::Rect(left, top, right - left + 1, bottom - top + 1);
+
+    // No white background around it, the profiles say nothing
+    if (bounds.width >= image.cols - 2 && bounds.height >= image.rows - 2) {
+        return false;
+    }
+
+    // A photo is solid: most lines across it are dark for most of their length.
+    // Separate objects or a light, patchy photo leave gaps in the profiles.
+    int solidRows = 0;
+    for (int y = top; y <= bottom; y++) {
+        if (rowCounts[y] >= bounds.width / 2) {
+            solidRows++;
+        }
+    }
+    int solidColumns = 0;
+    for (int x = left; x <= right; x++) {
+        if (columnCounts[x] >= bounds.height / 2) {
+            solidColumns++;
+        }
+    }
+
+    confidence = std::min(static_cast<double>(solidRows) / bounds.height,
+                          static_cast<double>(solidColumns) / bounds.width);
+    return confidence >= kMinProfileConfidence;
+}
+
+QList<QRect> AutoCrop::detectFrames(const cv::Mat& strip, int threshold) const {
+    QList<QRect> frames;
+    if (strip.empty() || strip.depth() != CV_8U || (strip.channels() != 1 && strip.channels() != 3)) {
+        return frames;
+    }
+
+    std::vector<int> rowCounts;
+    std::vector<int> columnCounts;
+    darknessProfiles(strip, threshold, rowCounts, columnCounts);
+
+    // Frames follow each other along the long side
+    const bool vertical = strip.rows >= strip.cols;
+    const std::vector<int>& profile = vertical ? rowCounts : columnCounts;
+    const int length = static_cast<int>(profile.size());
+    const int across = vertical ? strip.cols : strip.rows;
+
+    // A gutter is a run of nearly white lines
+    const int maxGutterPixels = std::max(3, across / 50);
+    const int minGutter = std::max(2, length / 100);
+
+    // Runs of content lines [first, second)
+    std::vector<std::pair<int, int>> runs;
+    int start = -1;
+    int blank = 0;
+    for (int i = 0; i < length; i++) {
+        if (profile[i] > maxGutterPixels) {
+            if (start < 0) {
+                start = i;
+            } else if (blank >= minGutter) {
+                runs.push_back({start, i - blank});
+                start = i;
+            }
+            blank = 0;
+        } else if (start >= 0) {
+            blank++;
+        }
+    }
+    if (start >= 0) {
+        runs.push_back({start, length - blank});
+    }
+
+    // Captions and logos are much shorter than the photos
+    int longest = 0;
+    for (const auto& run : runs) {
+        longest = std::max(longest, run.second - run.first);
+    }
+    runs.erase(std::remove_if(runs.begin(), runs.end(), [longest](const std::pair<int, int>& run) {
+                   return run.second - run.first < kMinFrameRatio * longest;
+               }),
+               runs.end());
+
+    if (runs.size() < 2 || runs.size() > static_cast<size_t>(kMaxFrames)) {
+        return frames;
+    }
+
+    for (size_t i = 0; i < runs.size(); i++) {
+        // The margin never reaches past the middle of a gutter
+        const int before = runs[i].first - (i > 0 ? runs[i - 1].second : 0);
+        const int after = (i + 1 < runs.size() ? runs[i + 1].first : length) - runs[i].second;
+        const int first = runs[i].first - std::min(kFrameMargin, i > 0 ? before / 2 : before);
+        const int last = runs[i].second + std::min(kFrameMargin, i + 1 < runs.size() ? after / 2 : after);
+
+        frames.append(vertical ? QRect(0, first, strip.cols, last - first)
+                               : QRect(first, 0, last - first, strip.rows));
+    }
+
+    qInfo() << "Auto-crop: Strip has" << frames.size() << "frames";
+    return frames;
+}
+
+double AutoCrop::estimateSkew(const cv::Mat& image, const cv::Rect& bounds, int threshold) const {
+    const int channels = image.channels();
+    const uchar cutoff = cv::saturate_cast<uchar>(threshold);
+    const cv::Rect area = bounds & cv::Rect(0, 0, image.cols, image.rows);
+    if (area.width < kSkewSamples || area.height < 4) {
+        return 0.0;
+    }
+
+    // Deepest an edge can lie below the box at the largest trusted skew
+    const int reach = std::min(area.height / 2,
+                               static_cast<int>(std::ceil(area.width * std::tan(kMaxDeskewAngle * CV_PI / 180.0))) + 2);
+    const int step = std::max(1, area.width / kSkewSamples);
+    // Rounded photo corners are left out
+    const int inset = area.width / 10;
+
+    auto isDark = [&](int x, int y) {
+        const uchar* pixel = image.ptr<uchar>(y) + x * channels;
+        return (channels == 3 ? std::min({pixel[0], pixel[1], pixel[2]}) : pixel[0]) < cutoff;
+    };
+
+    double slopeSum = 0.0;
+    int fits = 0;
+    for (int edge = 0; edge < 2; edge++) {
+        std::vector<cv::Point2f> points;
+        for (int x = area.x + inset; x < area.x + area.width - inset; x += step) {
+            for (int depth = 0; depth < reach; depth++) {
+                const int y = edge == 0 ? area.y + depth : area.y + area.height - 1 - depth;
+                if (isDark(x, y)) {
+                    points.push_back(cv::Point2f(static_cast<float>(x), static_cast<float>(y)));
+                    break;
+                }
+            }
+        }
+
+        if (points.size() < kSkewSamples / 4) {
+            continue;
+        }
+
+        // Huber weighting keeps light patches along the edge from pulling the line
+        cv::Vec4f line;
+        cv::fitLine(points, line, cv::DIST_HUBER, 0, 0.01, 0.01);
+        if (std::abs(line[0]) > 1e-6) {
+            slopeSum += line[1] / line[0];
+            fits++;
+        }
+    }
+
+    return fits > 0 ? std::atan(slopeSum / fits) * 180.0 / CV_PI : 0.0;
+}
+
+bool AutoCrop::needsDeskew(double angle) {
+    return std::abs(angle) >= kMinDeskewAngle && std::abs(angle) <= kMaxDeskewAngle;
+}
+
+cv::Mat AutoCrop::cropDeskewed(const cv::Mat& image, const QRect& bounds, double angle) const {
+    const double radians = angle * CV_PI / 180.0;
+    const double c = std::cos(radians);
+    const double s = std::sin(radians);
+
+    // Size of the rotated photo whose bounding rect is bounds
+    const double boxWidth = bounds.width();
+    const double boxHeight = bounds.height();
+    const double cos2 = c * c - s * s;
+    const int width = qRound((boxWidth * c - boxHeight * std::abs(s)) / cos2);
+    const int height = qRound((boxHeight * c - boxWidth * std::abs(s)) / cos2);
+    if (width <= 0 || height <= 0) {
+        return cv::Mat();
+    }
+
+    // Only the bounding rect is read; each output pixel maps back into it
+    const cv::Rect roi = cv::Rect(bounds.x(), bounds.y(), bounds.width(), bounds.height()) &
+                         cv::Rect(0, 0, image.cols, image.rows);
+    if (roi.empty()) {
+        return cv::Mat();
+    }
+    const double centerX = bounds.x() + boxWidth / 2.0 - roi.x;
+    const double centerY = bounds.y() + boxHeight / 2.0 - roi.y;
+
+    const cv::Mat toSource = (cv::Mat_<double>(2, 3) <<
+        c, -s, centerX - c * width / 2.0 + s * height / 2.0,
+        s,  c, centerY - s * width / 2.0 - c * height / 2.0);
+
+    cv::Mat straightened;
+    cv::warpAffine(image(roi), straightened, toSource, cv::Size(width, height),
+                   cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_REPLICATE);
+    return straightened;
+}
+
+bool AutoCrop::isGrayscale(const cv::Mat& image) const {
+    if (image.empty() || image.depth() != CV_8U) {
+        return false;
+    }
+    if (image.channels() == 1) {
+        return true;
+    }
+    if (image.channels() != 3) {
+        return false;
+    }
+
+    cv::Mat sample = image;
+    const double scale = static_cast<double>(kChromaSampleSize) / std::max(image.cols, image.rows);
+    if (scale < 1.0) {
+        cv::resize(image, sample,
+                   cv::Size(std::max(1, qRound(image.cols * scale)), std::max(1, qRound(image.rows * scale))),
+                   0, 0, cv::INTER_AREA);
+    }
+
+    int coloured = 0;
+    for (int y = 0; y < sample.rows; y++) {
+        const uchar* p = sample.ptr<uchar>(y);
+        for (int x = 0; x < sample.cols; x++, p += 3) {
+            const int high = std::max({p[0], p[1], p[2]});
+            const int low = std::min({p[0], p[1], p[2]});
+            if (high - low > kChromaTolerance) {
+                coloured++;
+            }
+        }
+    }
+
+    return coloured <= kColourFraction * sample.total();
+}
+
+std::vector<cv::Point> AutoCrop::findPhotoCorners(const cv::Mat& image, int threshold, double& angle) {
+    angle = 0.0;
+
+    int scale = 1;
+    while (scale < kPyramidScale && std::max(image.cols, image.rows) / (2 * scale) >= kCoarseMinSide) {
+        scale *= 2;
+    }
+    if (scale == 1) {
+        std::vector<cv::Point> corners = findLargestRectangle(image, threshold);
+        if (corners.size() == 4) {
+            angle = quadAngle(orderPoints(corners));
+        }
+        return corners;
+    }
+
+    std::vector<cv::Point> corners;
+    cv::Mat coarse = blurredGrayDownsample(image, scale);
+    if (!coarse.empty()) {
+        corners = findRectangleInBlurred(coarse, threshold);
+    } else {
+        cv::resize(image, coarse, cv::Size((image.cols + scale - 1) / scale, (image.rows + scale - 1) / scale),
+                   0, 0, cv::INTER_AREA);
+        corners = findLargestRectangle(coarse, threshold);
+    }
+    if (corners.size() != 4) {
+        return corners;
+    }
+
+    const double scaleX = static_cast<double>(image.cols) / coarse.cols;
+    const double scaleY = static_cast<double>(image.rows) / coarse.rows;
+    for (cv::Point& corner : corners) {
+        corner.x = qRound(corner.x * scaleX);
+        corner.y = qRound(corner.y * scaleY);
+    }
+    // The skew comes from the coarse quad, the refined box has none
+    angle = quadAngle(orderPoints(corners));
+
+    const cv::Rect bounds = refineBounds(image, cv::boundingRect(corners), scale);
+    qInfo() << "Auto-crop: Contour found at 1 /" << scale << "scale, refined bounds:"
+            << QRect(bounds.x, bounds.y, bounds.width, bounds.height);
+
+    return {bounds.tl(),
+            cv::Point(bounds.x + bounds.width, bounds.y),
+            bounds.br(),
+            cv::Point(bounds.x, bounds.y + bounds.height)};
+}
+
+cv::Rect AutoCrop::refineBounds(const cv::Mat& image, const cv::Rect& coarse, int scale) const {
+    const cv::Rect imageRect(0, 0, image.cols, image.rows);
+    // The coarse contour is off by the blur and dilation, a few coarse pixels
+    const int reach = 4 * scale;
+
+    double edges[4] = {static_cast<double>(coarse.x), static_cast<double>(coarse.y),
+                       static_cast<double>(coarse.x + coarse.width),
+                       static_cast<double>(coarse.y + coarse.height)};
+
+    // Sides: left, top, right, bottom
+    for (int side = 0; side < 4; side++) {
+        const bool vertical = side % 2 == 0;
+        const bool outsideFirst = side < 2;
+        const int edge = qRound(edges[side]);
+
+        cv::Rect band = vertical ? cv::Rect(edge - reach, coarse.y, 2 * reach, coarse.height)
+                                 : cv::Rect(coarse.x, edge - reach, coarse.width, 2 * reach);
+        band &= imageRect;
+        const int across = vertical ? band.width : band.height;
+        const int along = vertical ? band.height : band.width;
+        if (across < 4 || along < kEdgeSegments) {
+            continue;
+        }
+
+        // Only the band is converted, never the whole image
+        cv::Mat gray;
+        if (image.channels() == 1) {
+            gray = image(band);
+        } else {
+            cv::cvtColor(image(band), gray, image.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+        }
+
+        const int bandStart = vertical ? band.x : band.y;
+        bool found = false;
+        double outermost = 0.0;
+
+        for (int segment = 0; segment < kEdgeSegments; segment++) {
+            const int from = along * segment / kEdgeSegments;
+            const int to = along * (segment + 1) / kEdgeSegments;
+
+            cv::Mat means;
+            if (vertical) {
+                cv::reduce(gray.rowRange(from, to), means, 0, cv::REDUCE_AVG, CV_64F);
+            } else {
+                cv::reduce(gray.colRange(from, to), means, 1, cv::REDUCE_AVG, CV_64F);
+            }
+
+            std::vector<double> profile(means.begin<double>(), means.end<double>());
+            if (!outsideFirst) {
+                std::reverse(profile.begin(), profile.end());
+            }
+
+            const double position = stepPosition(profile);
+            if (position < 0.0) {
+                continue;
+            }
+
+            // Pixel centres lie at +0.5
+            const double coordinate = outsideFirst ? bandStart + position + 0.5
+                                                   : bandStart + across - position - 0.5;
+            if (!found || (outsideFirst ? coordinate < outermost : coordinate > outermost)) {
+                outermost = coordinate;
+                found = true;
+            }
+        }
+
+        if (found) {
+            edges[side] = outermost;
+        }
+    }
+
+    const int left = static_cast<int>(std::floor(edges[0]));
+    const int top = static_cast<int>(std::floor(edges[1]));
+    const int right = static_cast<int>(std::ceil(edges[2]));
+    const int bottom = static_cast<int>(std::ceil(edges[3]));
+
+    const cv::Rect refined = cv::Rect(left, top, right - left, bottom - top) & imageRect;
+    return refined.area() > 0 ? refined : coarse;
+}
+
 std::vector<cv::Point> AutoCrop::findLargestRectangle(const cv::Mat& image, int threshold) {
     try {
         if (image.empty()) {
@@ -146,6 +783,22 @@ std::vector<cv::Point> AutoCrop::findLargestRectangle(const cv::Mat& image, int
             return std::vector<cv::Point>();
         }
 
+        return findRectangleInBlurred(blurred, threshold);
+
+    } catch (const cv::Exception& e) {
+        qCritical() << "Auto-crop: OpenCV exception in findLargestRectangle:" << e.what();
+        return std::vector<cv::Point>();
+    } catch (const std::exception& e) {
+        qCritical() << "Auto-crop: Standard exception in findLargestRectangle:" << e.what();
+        return std::vector<cv::Point>();
+    } catch (...) {
+        qCritical() << "Auto-crop: Unknown exception in findLargestRectangle";
+        return std::vector<cv::Point>();
+    }
+}
+
+std::vector<cv::Point> AutoCrop::findRectangleInBlurred(const cv::Mat& blurred, int threshold) {
+    try {
         // Edge detection using Canny
         cv::Mat edges;
         try {
@@ -224,13 +877,10 @@ std::vector<cv::Point> AutoCrop::findLargestRectangle(const cv::Mat& image, int
         return corners;
 
     } catch (const cv::Exception& e) {
-        qCritical() << "Auto-crop: OpenCV exception in findLargestRectangle:" << e.what();
+        qCritical() << "Auto-crop: OpenCV exception in findRectangleInBlurred:" << e.what();
         return std::vector<cv::Point>();
     } catch (const std::exception& e) {
-        qCritical() << "Auto-crop: Standard exception in findLargestRectangle:" << e.what();
-        return std::vector<cv::Point>();
-    } catch (...) {
-        qCritical() << "Auto-crop: Unknown exception in findLargestRectangle";
+        qCritical() << "Auto-crop: Standard exception in findRectangleInBlurred:" << e.what();
         return std::vector<cv::Point>();
     }
 }
@@ -1,54 +1,571 @@
 #include "ImageProcessor.h"
 #include <QImage>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QElapsedTimer>
 #include <QDebug>
 #include <QtConcurrent>
 #include <jpeglib.h>
 #include <tiffio.h>
+#include <algorithm>
+#include <cmath>
 #include <opencv2/opencv.hpp>
+#include "JpegCropper.h"
+#include "JpegStripeEncoder.h"
+#include "SystemMemory.h"
+#include "TiffRegionReader.h"
+
+namespace {
+// Scaled DCT decode used to find the photo in scanner JPEGs
+constexpr int kJpegThumbnailScale = 8;
+// Row-sampled preview used to find the photo in spilled TIFF pages
+constexpr int kTiffPreviewScale = 8;
+// Memory for running jobs when neither the settings nor the system say
+constexpr qint64 kDefaultMemoryBudget = 512LL * 1024 * 1024;
+// Decoded size of a scanner JPEG relative to its compressed size, roughly
+constexpr qint64 kJpegDecodedRatio = 10;
+}
 
 ImageProcessor::ImageProcessor(AppSettings* settings, QObject* parent)
     : QObject(parent)
     , m_settings(settings)
+    , m_nextJobId(1)
+    , m_runningJobs(0)
+    , m_runningBytes(0)
+    , m_memoryBudget(0)
 {
+    // Jobs get their own workers, and the frame and stripe encodes and TIFF
+    // decodes inside a job run on them too, so processing never takes more
+    // threads than configured. A job waiting for its parts runs the ones no
+    // worker has picked up yet itself, so a full pool cannot deadlock.
+    m_workerPool.setMaxThreadCount(std::max(1, settings->processingWorkers));
+
+    if (settings->processingMemoryMb > 0) {
+        m_memoryBudget = static_cast<qint64>(settings->processingMemoryMb) * 1024 * 1024;
+    } else {
+        const qint64 available = availableMemoryBytes();
+        m_memoryBudget = available > 0 ? available / 2 : kDefaultMemoryBudget;
+    }
+    qInfo() << "ImageProcessor:" << m_workerPool.maxThreadCount() << "worker(s),"
+            << m_memoryBudget / (1024 * 1024) << "MB for running jobs";
 }
 
 ImageProcessor::~ImageProcessor() {
-    if (m_processingFuture.isRunning()) {
-        m_processingFuture.waitForFinished();
+    while (!m_queue.isEmpty()) {
+        Job job = m_queue.dequeue();
+        if (job.discard) {
+            job.discard();
+        }
     }
+    m_workerPool.waitForDone();
 }
 
-void ImageProcessor::processImage(const QString& inputPath, const QString& outputPath) {
-    emit processingStarted();
+int ImageProcessor::processImage(const QString& inputPath, const QString& outputPath, bool removeInput) {
     qInfo() << "Processing image:" << inputPath << "->" << outputPath;
 
-    // Process in background thread
-    m_processingFuture = QtConcurrent::run([this, inputPath, outputPath]() {
-        processImageTask(inputPath, outputPath);
-    });
+    // The decoded page is about as large as the uncompressed spill file,
+    // and the crop and its encode need about as much again
+    Job job;
+    job.outputPath = outputPath;
+    job.memoryBytes = 2 * QFileInfo(inputPath).size();
+    const QSize outputSize = m_outputSize;
+    job.run = [this, inputPath, outputPath, removeInput, outputSize](QStringList& framePaths, QString&) {
+        QPoint origin;
+        cv::Mat image = loadTiffRegion(inputPath, origin);
+        if (image.empty()) {
+            image = loadImage(inputPath);
+            origin = QPoint();
+        }
+        if (removeInput) {
+            QFile::remove(inputPath);
+        }
+        return cropAndConvert(image, outputPath, outputSize, framePaths, origin);
+    };
+    if (removeInput) {
+        job.discard = [inputPath]() { QFile::remove(inputPath); };
+    }
+    return enqueue(job);
+}
+
+int ImageProcessor::processImage(const cv::Mat& image, const QString& outputPath,
+                                 std::shared_ptr<ScanPipeline> pipeline) {
+    qInfo() << "Processing scanned image:" << image.cols << "x" << image.rows << "->" << outputPath;
+
+    // The Mat shares the scanner's buffer; the crop and its encode need about as much again
+    Job job;
+    job.outputPath = outputPath;
+    job.memoryBytes = static_cast<qint64>(image.total() * image.elemSize());
+    const QSize outputSize = m_outputSize;
+    job.run = [this, image, outputPath, outputSize, pipeline](QStringList& framePaths, QString&) {
+        return processImageTask(image, outputPath, outputSize, framePaths, pipeline);
+    };
+    return enqueue(job);
+}
+
+bool ImageProcessor::processImageTask(const cv::Mat& image, const QString& outputPath, const QSize& outputSize,
+                                      QStringList& framePaths, std::shared_ptr<ScanPipeline> pipeline) {
+    // Most of the work was done by the streaming pipeline during the scan
+    bool success = pipeline && pipeline->finish(outputPath);
+
+    if (success && m_settings->splitFrames) {
+        // The strip is written already, its frames come from the scanned page
+        const QRect rect = pipeline->cropRect();
+        cv::Mat strip = image(cv::Rect(rect.x(), rect.y(), rect.width(), rect.height()));
+        if (pipeline->isGrayscale() && strip.channels() == 3) {
+            cv::Mat gray;
+            cv::cvtColor(strip, gray, cv::COLOR_BGR2GRAY);
+            strip = gray;
+        }
+        FrameJobs frameJobs = startFrames(strip, outputPath, jpegQuality());
+        framePaths = finishFrames(frameJobs);
+    }
+
+    if (!success) {
+        if (pipeline) {
+            qInfo() << "ImageProcessor: Streaming result not usable, processing full frame";
+        }
+        success = cropAndConvert(image, outputPath, outputSize, framePaths);
+    }
+    return success;
+}
+
+int ImageProcessor::processJpeg(const QByteArray& jpeg, const QString& outputPath) {
+    qInfo() << "Processing scanner JPEG:" << jpeg.size() / 1024 << "KB ->" << outputPath;
+
+    // Budgeted for the full decode, which skewed photos need
+    Job job;
+    job.outputPath = outputPath;
+    job.memoryBytes = kJpegDecodedRatio * jpeg.size();
+    const QSize outputSize = m_outputSize;
+    job.run = [this, jpeg, outputPath, outputSize](QStringList& framePaths, QString&) {
+        // The lossless crop keeps the scanned pixels, so profiles that are
+        // scaled to a fixed output size take the decoding path
+        bool success = outputSize.isEmpty() && cropJpeg(jpeg, outputPath, framePaths);
+
+        if (!success) {
+            qInfo() << "ImageProcessor: No lossless crop, decoding full JPEG";
+            cv::Mat image = cv::imdecode(cv::Mat(1, jpeg.size(), CV_8UC1, const_cast<char*>(jpeg.constData())),
+                                         cv::IMREAD_COLOR);
+            success = !image.empty() && cropAndConvert(image, outputPath, outputSize, framePaths);
+        }
+        return success;
+    };
+    return enqueue(job);
+}
+
+int ImageProcessor::enqueue(Job job) {
+    job.id = m_nextJobId++;
+    job.sessionId = m_sessionId;
+    m_sessionJobs[job.sessionId].append(job.id);
+    m_queue.enqueue(job);
+
+    if (m_queue.size() > 1) {
+        qInfo() << "ImageProcessor: Job" << job.id << "queued behind" << m_queue.size() - 1 << "other(s)";
+    }
+    dispatchJobs();
+    return job.id;
+}
+
+void ImageProcessor::dispatchJobs() {
+    while (!m_queue.isEmpty() && m_runningJobs < m_workerPool.maxThreadCount()) {
+        // Oldest first; a job always runs on its own, however large it is
+        if (m_runningJobs > 0 && m_runningBytes + m_queue.head().memoryBytes > m_memoryBudget) {
+            qInfo() << "ImageProcessor: Job" << m_queue.head().id << "waits for memory,"
+                    << m_runningBytes / (1024 * 1024) << "MB in use";
+            return;
+        }
+
+        const Job job = m_queue.dequeue();
+        m_runningJobs++;
+        m_runningBytes += job.memoryBytes;
+        emit processingStarted(job.id);
+
+        m_workerPool.start([this, job]() {
+            Result result;
+            result.outputPath = job.outputPath;
+            try {
+                result.success = job.run(result.framePaths, result.errorMessage);
+            } catch (const std::exception& e) {
+                qCritical() << "Image processing exception:" << e.what();
+                result.success = false;
+                result.errorMessage = QString("Processing error: %1").arg(e.what());
+            }
+            if (!result.success && result.errorMessage.isEmpty()) {
+                result.errorMessage = "Failed to process image";
+            }
+
+            // Bookkeeping and signals happen on the owner's thread
+            QMetaObject::invokeMethod(this, [this, job, result]() {
+                onJobFinished(job.sessionId, job.id, job.memoryBytes, result);
+            }, Qt::QueuedConnection);
+        });
+    }
+}
+
+void ImageProcessor::onJobFinished(const QString& sessionId, int jobId, qint64 memoryBytes, const Result& result) {
+    m_runningJobs--;
+    m_runningBytes -= memoryBytes;
+
+    if (!m_sessionJobs.value(sessionId).contains(jobId)) {
+        // The session was cancelled while the job ran
+        qInfo() << "ImageProcessor: Dropping job" << jobId << "of a cancelled session";
+        if (result.success) {
+            removeFiles(QStringList(result.outputPath) + result.framePaths);
+        }
+    } else {
+        m_results.insert(jobId, result);
+        reportResults(sessionId);
+    }
+
+    dispatchJobs();
+}
+
+void ImageProcessor::reportResults(const QString& sessionId) {
+    // In start order: a finished job waits for the earlier jobs of its session.
+    // Slots may start or cancel jobs, so the session is looked up every time.
+    while (true) {
+        auto jobs = m_sessionJobs.find(sessionId);
+        if (jobs == m_sessionJobs.end()) {
+            return;
+        }
+        if (jobs->isEmpty()) {
+            m_sessionJobs.erase(jobs);
+            return;
+        }
+        const int jobId = jobs->first();
+        if (!m_results.contains(jobId)) {
+            return;
+        }
+        jobs->removeFirst();
+
+        const Result result = m_results.take(jobId);
+        if (result.success) {
+            qInfo() << "Image processing completed:" << result.outputPath;
+            emit processingCompleted(jobId, result.outputPath, result.framePaths);
+        } else {
+            qCritical() << "Image processing failed:" << result.errorMessage;
+            emit processingFailed(jobId, result.errorMessage);
+        }
+    }
+}
+
+void ImageProcessor::cancelSession(const QString& sessionId) {
+    int dropped = 0;
+    for (auto it = m_queue.begin(); it != m_queue.end();) {
+        if (it->sessionId == sessionId) {
+            if (it->discard) {
+                it->discard();
+            }
+            it = m_queue.erase(it);
+            dropped++;
+        } else {
+            ++it;
+        }
+    }
+
+    // Finished results still waiting for an earlier job are dropped too
+    for (int jobId : m_sessionJobs.take(sessionId)) {
+        if (m_results.contains(jobId)) {
+            const Result result = m_results.take(jobId);
+            if (result.success) {
+                removeFiles(QStringList(result.outputPath) + result.framePaths);
+            }
+        }
+    }
+
+    if (dropped > 0) {
+        qInfo() << "ImageProcessor: Dropped" << dropped << "queued job(s) of cancelled session";
+    }
 }
 
-void ImageProcessor::processImageTask(const QString& inputPath, const QString& outputPath) {
+bool ImageProcessor::cropJpeg(const QByteArray& jpeg, const QString& outputPath, QStringList& framePaths) {
+    QElapsedTimer timer;
+    timer.start();
+
+    cv::Mat thumbnail;
+    QSize fullSize;
+    if (!JpegCropper::thumbnail(jpeg, kJpegThumbnailScale, thumbnail, fullSize) || thumbnail.empty()) {
+        qWarning() << "ImageProcessor: Cannot decode scanner JPEG";
+        return false;
+    }
+
     try {
-        bool success = cropAndConvert(inputPath, outputPath);
+        AutoCrop::CropResult result = m_autoCrop.detectPhotoBounds(thumbnail, m_settings->cropDetectionThreshold);
+
+        // Thumbnail pixels back to full-size pixels; the thumbnail size is rounded up
+        const double scaleX = static_cast<double>(fullSize.width()) / thumbnail.cols;
+        const double scaleY = static_cast<double>(fullSize.height()) / thumbnail.rows;
+        auto toFullSize = [scaleX, scaleY](const QRect& rect) {
+            return QRect(static_cast<int>(rect.x() * scaleX),
+                         static_cast<int>(rect.y() * scaleY),
+                         static_cast<int>(std::ceil(rect.width() * scaleX)),
+                         static_cast<int>(std::ceil(rect.height() * scaleY)));
+        };
 
+        // Only right angles can be rotated losslessly; a skewed photo is decoded and straightened
+        if (result.success && m_settings->deskew && AutoCrop::needsDeskew(result.angle)) {
+            qInfo() << "ImageProcessor: Photo is skewed by" << result.angle << "degrees";
+            return false;
+        }
+
+        QRect cropRect;
+        if (result.success) {
+            cropRect = toFullSize(result.cropRect);
+            qInfo() << "ImageProcessor: Auto-crop on" << thumbnail.cols << "x" << thumbnail.rows
+                    << "thumbnail successful. Bounds:" << cropRect;
+        } else {
+            qWarning() << "ImageProcessor: Auto-crop detection failed:" << result.errorMessage;
+            cropRect = manualCropRect(fullSize.width(), fullSize.height());
+        }
+
+        const QRect thumbRect = result.success ? result.cropRect : QRect(0, 0, thumbnail.cols, thumbnail.rows);
+        const cv::Rect roi = cv::Rect(thumbRect.x(), thumbRect.y(), thumbRect.width(), thumbRect.height()) &
+                             cv::Rect(0, 0, thumbnail.cols, thumbnail.rows);
+
+        // Dropping the chroma components of a black-and-white photo is lossless too
+        const bool grayscale = m_settings->grayscaleDetection && thumbnail.channels() == 3 &&
+                               !roi.empty() && m_autoCrop.isGrayscale(thumbnail(roi));
+
+        // Frames are found on the thumbnail and cut losslessly from the full JPEG,
+        // on the thread pool while the strip is cropped here
+        FrameJobs frameJobs;
+        if (m_settings->splitFrames && result.success && !roi.empty()) {
+            QList<QRect> frames;
+            for (const QRect& frame : m_autoCrop.detectFrames(thumbnail(roi), m_settings->cropDetectionThreshold)) {
+                frames.append(toFullSize(frame.translated(roi.x, roi.y)));
+            }
+            frameJobs = startJpegFrames(jpeg, frames, outputPath, grayscale);
+        }
+
+        QByteArray cropped;
+        QRect usedRect;
+        bool success = JpegCropper::crop(jpeg, cropRect, cropped, usedRect, grayscale);
         if (success) {
-            qInfo() << "Image processing completed:" << outputPath;
-            emit processingCompleted(outputPath);
+            QFile file(outputPath);
+            success = file.open(QIODevice::WriteOnly) && file.write(cropped) == cropped.size();
+            if (!success) {
+                qCritical() << "ImageProcessor: Failed to save JPEG:" << outputPath;
+            }
+        }
+
+        const QStringList frames = finishFrames(frameJobs);
+        if (!success) {
+            removeFiles(frames);
+            return false;
+        }
+        framePaths = frames;
+
+        qInfo() << "ImageProcessor: Losslessly cropped to" << usedRect << (grayscale ? "(grayscale)" : "")
+                << "in" << timer.elapsed() << "ms";
+        return true;
+
+    } catch (const cv::Exception& e) {
+        qCritical() << "ImageProcessor: OpenCV exception in cropJpeg:" << e.what();
+        return false;
+    }
+}
+
+ImageProcessor::FrameJobs ImageProcessor::startFrames(const cv::Mat& strip, const QString& outputPath, int quality) {
+    FrameJobs jobs;
+    const QList<QRect> frames = m_autoCrop.detectFrames(strip, m_settings->cropDetectionThreshold);
+
+    for (int i = 0; i < frames.size(); i++) {
+        const cv::Rect rect = cv::Rect(frames[i].x(), frames[i].y(), frames[i].width(), frames[i].height()) &
+                              cv::Rect(0, 0, strip.cols, strip.rows);
+        if (rect.empty()) {
+            continue;
+        }
+
+        // The frame shares the strip's pixels; each encode only reads them
+        const cv::Mat frame = strip(rect);
+        const QString path = framePath(outputPath, i);
+        jobs.paths.append(path);
+        jobs.results.append(QtConcurrent::run(&m_workerPool, [this, frame, path, quality]() {
+            return saveJpeg(frame, path, quality);
+        }));
+    }
+    return jobs;
+}
+
+ImageProcessor::FrameJobs ImageProcessor::startJpegFrames(const QByteArray& jpeg, const QList<QRect>& frames,
+                                                          const QString& outputPath, bool grayscale) {
+    FrameJobs jobs;
+
+    for (int i = 0; i < frames.size(); i++) {
+        const QRect rect = frames[i];
+        const QString path = framePath(outputPath, i);
+        jobs.paths.append(path);
+        jobs.results.append(QtConcurrent::run(&m_workerPool, [jpeg, rect, path, grayscale]() {
+            QByteArray cropped;
+            QRect usedRect;
+            if (!JpegCropper::crop(jpeg, rect, cropped, usedRect, grayscale)) {
+                return false;
+            }
+            QFile file(path);
+            return file.open(QIODevice::WriteOnly) && file.write(cropped) == cropped.size();
+        }));
+    }
+    return jobs;
+}
+
+QStringList ImageProcessor::finishFrames(FrameJobs& jobs) {
+    QStringList written;
+    for (int i = 0; i < jobs.results.size(); i++) {
+        if (jobs.results[i].result()) {
+            written.append(jobs.paths[i]);
         } else {
-            qCritical() << "Image processing failed";
-            emit processingFailed("Failed to process image");
+            qWarning() << "ImageProcessor: Failed to save frame:" << jobs.paths[i];
+            QFile::remove(jobs.paths[i]);
         }
-    } catch (const std::exception& e) {
-        qCritical() << "Image processing exception:" << e.what();
-        emit processingFailed(QString("Processing error: %1").arg(e.what()));
     }
+
+    if (!written.isEmpty()) {
+        qInfo() << "ImageProcessor: Saved" << written.size() << "frames of the strip";
+    }
+    return written;
 }
 
-bool ImageProcessor::cropAndConvert(const QString& inputPath, const QString& outputPath) {
-    // Validate input parameters
+void ImageProcessor::removeFiles(const QStringList& paths) {
+    for (const QString& path : paths) {
+        QFile::remove(path);
+    }
+}
+
+QString ImageProcessor::framePath(const QString& outputPath, int frame) {
+    const QFileInfo info(outputPath);
+    return info.dir().filePath(QString("%1_photo_%2.jpg").arg(info.completeBaseName()).arg(frame + 1));
+}
+
+bool ImageProcessor::saveJpeg(const cv::Mat& image, const QString& path, int quality) {
+    QElapsedTimer timer;
+    timer.start();
+
+    // Stripes are encoded on the workers and stitched with restart markers
+    const JpegStripeEncoder encoder(image.cols, image.channels(), quality);
+    QByteArray jpeg;
+    if (image.depth() == CV_8U && encoder.isValid() && encoder.encode(image, jpeg, &m_workerPool)) {
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly) || file.write(jpeg) != jpeg.size()) {
+            qCritical() << "ImageProcessor: Failed to write JPEG:" << path;
+            return false;
+        }
+        file.close();
+        qInfo() << "ImageProcessor: Encoded" << image.cols << "x" << image.rows << "JPEG in"
+                << timer.elapsed() << "ms";
+        return true;
+    }
+
+    qWarning() << "ImageProcessor: Striped encoding unavailable, saving with OpenCV";
+    try {
+        return cv::imwrite(path.toStdString(), image, {cv::IMWRITE_JPEG_QUALITY, quality});
+    } catch (const cv::Exception& e) {
+        qCritical() << "ImageProcessor: OpenCV exception saving JPEG:" << e.what();
+        return false;
+    }
+}
+
+int ImageProcessor::jpegQuality() const {
+    int quality = m_settings->jpegQuality;
+    if (quality < 0 || quality > 100) {
+        qWarning() << "ImageProcessor: Invalid JPEG quality" << quality << "- using 85";
+        quality = 85;
+    }
+    return quality;
+}
+
+QRect ImageProcessor::manualCropRect(int imageWidth, int imageHeight) const {
+    qInfo() << "ImageProcessor: Falling back to manual crop settings";
+
+    int width = m_settings->cropX2 - m_settings->cropX1;
+    int height = m_settings->cropY2 - m_settings->cropY1;
+
+    if (width <= 0 || height <= 0) {
+        qWarning() << "ImageProcessor: Invalid manual crop dimensions:" << width << "x" << height;
+        // Use entire image as last resort
+        return QRect(0, 0, imageWidth, imageHeight);
+    }
+    return QRect(m_settings->cropX1, m_settings->cropY1, width, height);
+}
+
+cv::Mat ImageProcessor::loadImage(const QString& inputPath) {
     if (inputPath.isEmpty()) {
         qCritical() << "ImageProcessor: Input path is empty";
+        return cv::Mat();
+    }
+
+    cv::Mat cvImage;
+    try {
+        cvImage = cv::imread(inputPath.toStdString(), cv::IMREAD_COLOR);
+    } catch (const cv::Exception& e) {
+        qCritical() << "ImageProcessor: OpenCV exception loading image:" << e.what();
+        return cv::Mat();
+    } catch (const std::exception& e) {
+        qCritical() << "ImageProcessor: Exception loading image:" << e.what();
+        return cv::Mat();
+    }
+
+    if (cvImage.empty()) {
+        qCritical() << "ImageProcessor: Failed to load image:" << inputPath;
+        return cv::Mat();
+    }
+
+    qInfo() << "ImageProcessor: Loaded image:" << cvImage.cols << "x" << cvImage.rows;
+    return cvImage;
+}
+
+cv::Mat ImageProcessor::loadTiffRegion(const QString& inputPath, QPoint& origin) {
+    const QString suffix = QFileInfo(inputPath).suffix().toLower();
+    if (suffix != "tif" && suffix != "tiff") {
+        return cv::Mat();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    TiffRegionReader reader(&m_workerPool);
+    if (!reader.open(inputPath)) {
+        return cv::Mat();
+    }
+    const QRect full(QPoint(0, 0), reader.size());
+
+    // Only the strips around the photo are decoded; the margin leaves the
+    // background that the full-resolution detection needs around the edges
+    QRect region = full;
+    cv::Mat preview;
+    try {
+        if (reader.readPreview(kTiffPreviewScale, preview)) {
+            AutoCrop::CropResult result = m_autoCrop.detectPhotoBounds(preview, m_settings->cropDetectionThreshold);
+            if (result.success) {
+                const int margin = 4 * kTiffPreviewScale;
+                const QRect& bounds = result.cropRect;
+                region = QRect(bounds.x() * kTiffPreviewScale, bounds.y() * kTiffPreviewScale,
+                               bounds.width() * kTiffPreviewScale, bounds.height() * kTiffPreviewScale)
+                             .adjusted(-margin, -margin, margin, margin)
+                             .intersected(full);
+            }
+        }
+    } catch (const cv::Exception& e) {
+        qWarning() << "ImageProcessor: OpenCV exception on TIFF preview:" << e.what();
+        region = full;
+    }
+
+    cv::Mat image;
+    if (!reader.readRegion(region, image)) {
+        return cv::Mat();
+    }
+    origin = region.topLeft();
+
+    qInfo() << "ImageProcessor: Decoded" << image.cols << "x" << image.rows << "of"
+            << full.width() << "x" << full.height() << "TIFF in" << timer.elapsed() << "ms";
+    return image;
+}
+
+bool ImageProcessor::cropAndConvert(const cv::Mat& cvImage, const QString& outputPath, const QSize& outputSize,
+                                    QStringList& framePaths, const QPoint& origin) {
+    // Validate input parameters
+    if (cvImage.empty()) {
+        qCritical() << "ImageProcessor: Input image is empty";
         return false;
     }
 
@@ -63,25 +580,6 @@ bool ImageProcessor::cropAndConvert(const QString& inputPath, const QString& out
     }
 
     try {
-        // Load image using OpenCV for auto-crop detection
-        cv::Mat cvImage;
-        try {
-            cvImage = cv::imread(inputPath.toStdString(), cv::IMREAD_COLOR);
-        } catch (const cv::Exception& e) {
-            qCritical() << "ImageProcessor: OpenCV exception loading image:" << e.what();
-            return false;
-        } catch (const std::exception& e) {
-            qCritical() << "ImageProcessor: Exception loading image:" << e.what();
-            return false;
-        }
-
-        if (cvImage.empty()) {
-            qCritical() << "ImageProcessor: Failed to load image:" << inputPath;
-            return false;
-        }
-
-        qInfo() << "ImageProcessor: Loaded image:" << cvImage.cols << "x" << cvImage.rows;
-
         // Detect photo bounds using auto-crop
         qInfo() << "ImageProcessor: Detecting photo boundaries...";
         AutoCrop::CropResult result = m_autoCrop.detectPhotoBounds(cvImage, m_settings->cropDetectionThreshold);
@@ -89,19 +587,14 @@ bool ImageProcessor::cropAndConvert(const QString& inputPath, const QString& out
         QRect cropRect;
         if (!result.success) {
             qWarning() << "ImageProcessor: Auto-crop detection failed:" << result.errorMessage;
-            qInfo() << "ImageProcessor: Falling back to manual crop settings";
-
-            // Fallback to manual crop settings
-            int width = m_settings->cropX2 - m_settings->cropX1;
-            int height = m_settings->cropY2 - m_settings->cropY1;
-
-            if (width <= 0 || height <= 0) {
-                qWarning() << "ImageProcessor: Invalid manual crop dimensions:" << width << "x" << height;
-                // Use entire image as last resort
-                cropRect = QRect(0, 0, cvImage.cols, cvImage.rows);
-            } else {
-                cropRect = QRect(m_settings->cropX1, m_settings->cropY1, width, height);
+            // The manual area is in page coordinates; a region decoded from a
+            // spilled page only covers part of it
+            const QRect imageRect(origin, QSize(cvImage.cols, cvImage.rows));
+            cropRect = manualCropRect(imageRect.right() + 1, imageRect.bottom() + 1).intersected(imageRect);
+            if (cropRect.isEmpty()) {
+                cropRect = imageRect;
             }
+            cropRect.translate(-origin);
         } else {
             cropRect = result.cropRect;
             qInfo() << "ImageProcessor: Auto-crop successful. Bounds:" << cropRect;
@@ -137,7 +630,17 @@ bool ImageProcessor::cropAndConvert(const QString& inputPath, const QString& out
 
         cv::Mat cropped;
         try {
-            cropped = cvImage(cvCropRect);
+            // A skewed photo is cropped and straightened by one warp of the output area
+            if (result.success && m_settings->deskew && AutoCrop::needsDeskew(result.angle)) {
+                const QRect bounds(cvCropRect.x, cvCropRect.y, cvCropRect.width, cvCropRect.height);
+                cropped = m_autoCrop.cropDeskewed(cvImage, bounds, result.angle);
+                if (!cropped.empty()) {
+                    qInfo() << "ImageProcessor: Straightened by" << result.angle << "degrees";
+                }
+            }
+            if (cropped.empty()) {
+                cropped = cvImage(cvCropRect);
+            }
         } catch (const cv::Exception& e) {
             qCritical() << "ImageProcessor: OpenCV exception during crop:" << e.what();
             return false;
@@ -153,33 +656,48 @@ bool ImageProcessor::cropAndConvert(const QString& inputPath, const QString& out
 
         qInfo() << "ImageProcessor: Cropped to:" << cropped.cols << "x" << cropped.rows;
 
-        // Validate JPEG quality
-        int quality = m_settings->jpegQuality;
-        if (quality < 0 || quality > 100) {
-            qWarning() << "ImageProcessor: Invalid JPEG quality" << quality << "- using 85";
-            quality = 85;
+        // Fit the media profile's output size, matching its orientation to the crop
+        if (outputSize.isValid() && !outputSize.isEmpty()) {
+            QSize limit = outputSize;
+            if ((cropped.cols > cropped.rows) != (limit.width() > limit.height())) {
+                limit.transpose();
+            }
+            const double scale = std::min(static_cast<double>(limit.width()) / cropped.cols,
+                                          static_cast<double>(limit.height()) / cropped.rows);
+            if (scale < 1.0) {
+                cv::Mat scaled;
+                cv::resize(cropped, scaled, cv::Size(), scale, scale, cv::INTER_AREA);
+                cropped = scaled;
+                qInfo() << "ImageProcessor: Scaled to:" << cropped.cols << "x" << cropped.rows;
+            }
         }
 
-        // Save as JPEG with specified quality using OpenCV
-        std::vector<int> compression_params;
-        compression_params.push_back(cv::IMWRITE_JPEG_QUALITY);
-        compression_params.push_back(quality);
+        // Black-and-white photos are saved with a single channel
+        if (m_settings->grayscaleDetection && cropped.channels() == 3 && m_autoCrop.isGrayscale(cropped)) {
+            cv::Mat gray;
+            cv::cvtColor(cropped, gray, cv::COLOR_BGR2GRAY);
+            cropped = gray;
+            qInfo() << "ImageProcessor: No colour found, saving as grayscale";
+        }
 
-        bool success = false;
-        try {
-            success = cv::imwrite(outputPath.toStdString(), cropped, compression_params);
-        } catch (const cv::Exception& e) {
-            qCritical() << "ImageProcessor: OpenCV exception saving JPEG:" << e.what();
-            return false;
-        } catch (const std::exception& e) {
-            qCritical() << "ImageProcessor: Exception saving JPEG:" << e.what();
-            return false;
+        const int quality = jpegQuality();
+
+        // The frames of a strip are encoded on the thread pool alongside the strip
+        FrameJobs frameJobs;
+        if (m_settings->splitFrames) {
+            frameJobs = startFrames(cropped, outputPath, quality);
         }
 
+        // Save as JPEG with specified quality
+        const bool success = saveJpeg(cropped, outputPath, quality);
+
+        const QStringList frames = finishFrames(frameJobs);
         if (!success) {
             qCritical() << "ImageProcessor: Failed to save JPEG:" << outputPath;
+            removeFiles(frames);
             return false;
         }
+        framePaths = frames;
 
         qInfo() << "ImageProcessor: Image auto-cropped and converted successfully to:" << outputPath;
         return true;
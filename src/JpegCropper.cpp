@@ -0,0 +1,228 @@
+#include "JpegCropper.h"
+#include <QDebug>
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <jpeglib.h>
+
+namespace {
+
+struct JpegErrorManager {
+    jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+void jpegErrorExit(j_common_ptr cinfo) {
+    JpegErrorManager* err = reinterpret_cast<JpegErrorManager*>(cinfo->err);
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    qWarning() << "JpegCropper: libjpeg error:" << message;
+    longjmp(err->jump, 1);
+}
+
+// Keep warnings about corrupt data from flooding the log
+void jpegOutputMessage(j_common_ptr cinfo) {
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    qDebug() << "JpegCropper:" << message;
+}
+
+void setupErrors(j_common_ptr cinfo, JpegErrorManager& jerr) {
+    cinfo->err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpegErrorExit;
+    jerr.pub.output_message = jpegOutputMessage;
+}
+
+int divRoundUp(int a, int b) {
+    return (a + b - 1) / b;
+}
+
+} // namespace
+
+bool JpegCropper::thumbnail(const QByteArray& jpeg, int scaleDenom, cv::Mat& image, QSize& fullSize) {
+    if (jpeg.isEmpty()) {
+        return false;
+    }
+
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager jerr;
+    setupErrors(reinterpret_cast<j_common_ptr>(&cinfo), jerr);
+
+    if (setjmp(jerr.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, reinterpret_cast<unsigned char*>(const_cast<char*>(jpeg.constData())),
+                 static_cast<unsigned long>(jpeg.size()));
+    jpeg_read_header(&cinfo, TRUE);
+
+    fullSize = QSize(static_cast<int>(cinfo.image_width), static_cast<int>(cinfo.image_height));
+
+    // Scaling happens in the IDCT, skipped coefficients are never transformed
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = static_cast<unsigned int>(scaleDenom);
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.do_fancy_upsampling = FALSE;
+    if (cinfo.num_components == 1) {
+        cinfo.out_color_space = JCS_GRAYSCALE;
+    } else {
+#ifdef JCS_EXTENSIONS
+        cinfo.out_color_space = JCS_EXT_BGR;
+#else
+        cinfo.out_color_space = JCS_RGB;
+#endif
+    }
+
+    jpeg_start_decompress(&cinfo);
+
+    image.create(static_cast<int>(cinfo.output_height), static_cast<int>(cinfo.output_width),
+                 CV_8UC(cinfo.output_components));
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = image.ptr<uchar>(static_cast<int>(cinfo.output_scanline));
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+
+#ifndef JCS_EXTENSIONS
+    if (image.channels() == 3) {
+        // Swap R and B in place
+        for (int y = 0; y < image.rows; y++) {
+            uchar* p = image.ptr<uchar>(y);
+            for (int x = 0; x < image.cols; x++) {
+                std::swap(p[x * 3], p[x * 3 + 2]);
+            }
+        }
+    }
+#endif
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
+
+bool JpegCropper::crop(const QByteArray& jpeg, const QRect& rect, QByteArray& output, QRect& cropped,
+                       bool grayscale) {
+    if (jpeg.isEmpty() || rect.isEmpty()) {
+        return false;
+    }
+
+    jpeg_decompress_struct src;
+    jpeg_compress_struct dst;
+    JpegErrorManager jerr;
+    unsigned char* buffer = nullptr;
+    unsigned long bufferSize = 0;
+
+    // Both structs share one error manager, either can fail during the transcode
+    setupErrors(reinterpret_cast<j_common_ptr>(&src), jerr);
+    dst.err = src.err;
+
+    jpeg_create_decompress(&src);
+    jpeg_create_compress(&dst);
+    if (setjmp(jerr.jump)) {
+        jpeg_destroy_compress(&dst);
+        jpeg_destroy_decompress(&src);
+        free(buffer);
+        return false;
+    }
+
+    jpeg_mem_src(&src, reinterpret_cast<unsigned char*>(const_cast<char*>(jpeg.constData())),
+                 static_cast<unsigned long>(jpeg.size()));
+    jpeg_read_header(&src, TRUE);
+
+    const int imageWidth = static_cast<int>(src.image_width);
+    const int imageHeight = static_cast<int>(src.image_height);
+
+    int maxH = 1;
+    int maxV = 1;
+    for (int ci = 0; ci < src.num_components; ci++) {
+        maxH = std::max(maxH, src.comp_info[ci].h_samp_factor);
+        maxV = std::max(maxV, src.comp_info[ci].v_samp_factor);
+    }
+    const int mcuWidth = maxH * DCTSIZE;
+    const int mcuHeight = maxV * DCTSIZE;
+
+    // Only whole MCUs can be dropped at the left and top
+    QRect area = rect.intersected(QRect(0, 0, imageWidth, imageHeight));
+    if (area.isEmpty()) {
+        jpeg_destroy_compress(&dst);
+        jpeg_destroy_decompress(&src);
+        return false;
+    }
+    const int x0 = (area.left() / mcuWidth) * mcuWidth;
+    const int y0 = (area.top() / mcuHeight) * mcuHeight;
+    cropped = QRect(x0, y0, area.right() + 1 - x0, area.bottom() + 1 - y0);
+
+    // Grayscale output keeps only the Y component of a YCbCr file
+    const bool dropChroma = grayscale && src.jpeg_color_space == JCS_YCbCr && src.num_components == 3;
+    const int components = dropChroma ? 1 : src.num_components;
+
+    // Workspace for the cropped coefficients, sized like jpegtran does
+    std::vector<jvirt_barray_ptr> dstArrays(components);
+    std::vector<int> widthInBlocks(components);
+    std::vector<int> heightInBlocks(components);
+    for (int ci = 0; ci < components; ci++) {
+        const jpeg_component_info* comp = &src.comp_info[ci];
+        widthInBlocks[ci] = divRoundUp(cropped.width() * comp->h_samp_factor, mcuWidth);
+        heightInBlocks[ci] = divRoundUp(cropped.height() * comp->v_samp_factor, mcuHeight);
+        dstArrays[ci] = (*src.mem->request_virt_barray)(
+            reinterpret_cast<j_common_ptr>(&src), JPOOL_IMAGE, FALSE,
+            static_cast<JDIMENSION>(divRoundUp(widthInBlocks[ci], comp->h_samp_factor) * comp->h_samp_factor),
+            static_cast<JDIMENSION>(divRoundUp(heightInBlocks[ci], comp->v_samp_factor) * comp->v_samp_factor),
+            static_cast<JDIMENSION>(comp->v_samp_factor));
+    }
+
+    jvirt_barray_ptr* srcArrays = jpeg_read_coefficients(&src);
+
+    jpeg_copy_critical_parameters(&src, &dst);
+    if (dropChroma) {
+        // jpeg_set_colorspace resets the component, keep the luma quantization table
+        const int quantTable = dst.comp_info[0].quant_tbl_no;
+        jpeg_set_colorspace(&dst, JCS_GRAYSCALE);
+        dst.comp_info[0].quant_tbl_no = quantTable;
+    }
+    dst.image_width = static_cast<JDIMENSION>(cropped.width());
+    dst.image_height = static_cast<JDIMENSION>(cropped.height());
+    if (src.saw_JFIF_marker) {
+        dst.density_unit = src.density_unit;
+        dst.X_density = src.X_density;
+        dst.Y_density = src.Y_density;
+    }
+
+    jpeg_mem_dest(&dst, &buffer, &bufferSize);
+    jpeg_write_coefficients(&dst, dstArrays.data());
+
+    // Copy block rows; the coefficients are only read in finish_compress
+    for (int ci = 0; ci < components; ci++) {
+        const jpeg_component_info* comp = &src.comp_info[ci];
+        const int xBlocks = (x0 / mcuWidth) * comp->h_samp_factor;
+        const int yBlocks = (y0 / mcuHeight) * comp->v_samp_factor;
+
+        for (int by = 0; by < heightInBlocks[ci]; by += comp->v_samp_factor) {
+            JBLOCKARRAY dstRows = (*src.mem->access_virt_barray)(
+                reinterpret_cast<j_common_ptr>(&src), dstArrays[ci], static_cast<JDIMENSION>(by),
+                static_cast<JDIMENSION>(comp->v_samp_factor), TRUE);
+            JBLOCKARRAY srcRows = (*src.mem->access_virt_barray)(
+                reinterpret_cast<j_common_ptr>(&src), srcArrays[ci], static_cast<JDIMENSION>(by + yBlocks),
+                static_cast<JDIMENSION>(comp->v_samp_factor), FALSE);
+
+            for (int row = 0; row < comp->v_samp_factor; row++) {
+                std::memcpy(dstRows[row], srcRows[row] + xBlocks,
+                            static_cast<size_t>(widthInBlocks[ci]) * sizeof(JBLOCK));
+            }
+        }
+    }
+
+    jpeg_finish_compress(&dst);
+    jpeg_finish_decompress(&src);
+
+    output = QByteArray(reinterpret_cast<const char*>(buffer), static_cast<int>(bufferSize));
+
+    jpeg_destroy_compress(&dst);
+    jpeg_destroy_decompress(&src);
+    free(buffer);
+    return true;
+}
@@ -0,0 +1,257 @@
+#include "JpegStripeEncoder.h"
+#include <QDebug>
+#include <QtConcurrent>
+#include <algorithm>
+#include <atomic>
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <vector>
+#include <jpeglib.h>
+
+namespace {
+
+// Preferred stripe height in pixels, rounded down to whole MCU rows
+constexpr int kTargetStripeRows = 256;
+
+struct JpegErrorManager {
+    jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+void jpegErrorExit(j_common_ptr cinfo) {
+    JpegErrorManager* err = reinterpret_cast<JpegErrorManager*>(cinfo->err);
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    qWarning() << "JpegStripeEncoder: libjpeg error:" << message;
+    longjmp(err->jump, 1);
+}
+
+int readUInt16(const QByteArray& data, int pos) {
+    return (static_cast<uchar>(data[pos]) << 8) | static_cast<uchar>(data[pos + 1]);
+}
+
+// Find where the entropy-coded data starts (after the SOS header) and where
+// the SOF segment stores the image height
+bool parseHeader(const QByteArray& jpeg, int& scanStart, int& heightOffset) {
+    const int size = jpeg.size();
+    if (size < 4 || static_cast<uchar>(jpeg[0]) != 0xFF || static_cast<uchar>(jpeg[1]) != 0xD8) {
+        return false;
+    }
+
+    heightOffset = -1;
+    int pos = 2;
+    while (pos + 4 <= size) {
+        if (static_cast<uchar>(jpeg[pos]) != 0xFF) {
+            return false;
+        }
+
+        const uchar marker = static_cast<uchar>(jpeg[pos + 1]);
+        const int length = readUInt16(jpeg, pos + 2);
+
+        if (marker == 0xC0 || marker == 0xC1) {
+            heightOffset = pos + 5;
+        } else if (marker == 0xDA) {
+            scanStart = pos + 2 + length;
+            return heightOffset > 0 && scanStart <= size - 2;
+        }
+
+        pos += 2 + length;
+    }
+
+    return false;
+}
+
+} // namespace
+
+JpegStripeEncoder::JpegStripeEncoder(int width, int channels, int quality, int dpi)
+    : m_width(width)
+    , m_channels(channels)
+    , m_quality(std::clamp(quality, 1, 100))
+    , m_dpi(dpi)
+    , m_mcuRows(channels == 1 ? 8 : 16) // color uses 4:2:0 subsampling (16x16 MCUs)
+    , m_stripeRows(0)
+    , m_restartInterval(0)
+{
+    if (width <= 0 || width > 65535 || (channels != 1 && channels != 3)) {
+        qWarning() << "JpegStripeEncoder: Unsupported image layout" << width << "x" << channels;
+        return;
+    }
+
+    // Each stripe is one restart interval, which is limited to 65535 MCUs
+    const int mcuCols = (width + m_mcuRows - 1) / m_mcuRows;
+    const int mcuRowsPerStripe = std::max(1, std::min(kTargetStripeRows / m_mcuRows, 65535 / mcuCols));
+
+    m_stripeRows = mcuRowsPerStripe * m_mcuRows;
+    m_restartInterval = mcuRowsPerStripe * mcuCols;
+}
+
+bool JpegStripeEncoder::isValid() const {
+    return m_stripeRows > 0;
+}
+
+bool JpegStripeEncoder::encodeStripe(const cv::Mat& rows, QByteArray& stripe) const {
+    if (!isValid() || rows.empty() || rows.cols != m_width || rows.channels() != m_channels ||
+        rows.depth() != CV_8U || rows.rows > m_stripeRows) {
+        qWarning() << "JpegStripeEncoder: Invalid stripe" << rows.cols << "x" << rows.rows;
+        return false;
+    }
+
+#ifndef JCS_EXTENSIONS
+    // Without libjpeg-turbo extensions BGR rows have to be swapped to RGB
+    std::vector<JSAMPLE> lineBuffer(m_channels == 3 ? m_width * 3 : 0);
+#endif
+
+    jpeg_compress_struct cinfo;
+    JpegErrorManager jerr;
+    unsigned char* buffer = nullptr;
+    unsigned long bufferSize = 0;
+
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpegErrorExit;
+
+    if (setjmp(jerr.jump)) {
+        jpeg_destroy_compress(&cinfo);
+        free(buffer);
+        return false;
+    }
+
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &buffer, &bufferSize);
+
+    cinfo.image_width = m_width;
+    cinfo.image_height = rows.rows;
+    cinfo.input_components = m_channels;
+#ifdef JCS_EXTENSIONS
+    cinfo.in_color_space = m_channels == 3 ? JCS_EXT_BGR : JCS_GRAYSCALE;
+#else
+    cinfo.in_color_space = m_channels == 3 ? JCS_RGB : JCS_GRAYSCALE;
+#endif
+
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, m_quality, TRUE);
+
+    // Every stripe must use the same tables, so no per-stripe Huffman optimization
+    cinfo.optimize_coding = FALSE;
+    cinfo.restart_interval = m_restartInterval;
+
+    if (m_dpi > 0) {
+        cinfo.density_unit = 1; // dots per inch
+        cinfo.X_density = m_dpi;
+        cinfo.Y_density = m_dpi;
+    }
+
+    jpeg_start_compress(&cinfo, TRUE);
+
+    while (cinfo.next_scanline < cinfo.image_height) {
+        // Rows are fed straight from the Mat without an intermediate copy
+        JSAMPROW row = const_cast<JSAMPROW>(rows.ptr<uchar>(cinfo.next_scanline));
+#ifndef JCS_EXTENSIONS
+        if (m_channels == 3) {
+            for (int x = 0; x < m_width; x++) {
+                lineBuffer[x * 3] = row[x * 3 + 2];
+                lineBuffer[x * 3 + 1] = row[x * 3 + 1];
+                lineBuffer[x * 3 + 2] = row[x * 3];
+            }
+            row = lineBuffer.data();
+        }
+#endif
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg_finish_compress(&cinfo);
+
+    stripe = QByteArray(reinterpret_cast<const char*>(buffer), static_cast<int>(bufferSize));
+
+    jpeg_destroy_compress(&cinfo);
+    free(buffer);
+    return true;
+}
+
+bool JpegStripeEncoder::stitch(const QList<QByteArray>& stripes, QByteArray& jpeg) const {
+    if (!isValid() || stripes.isEmpty()) {
+        return false;
+    }
+
+    int totalSize = 0;
+    for (const QByteArray& stripe : stripes) {
+        totalSize += stripe.size();
+    }
+
+    jpeg.clear();
+    jpeg.reserve(totalSize);
+
+    int totalRows = 0;
+    int heightField = -1;
+
+    for (int i = 0; i < stripes.size(); i++) {
+        const QByteArray& stripe = stripes[i];
+
+        int scanStart = 0;
+        int heightOffset = 0;
+        if (!parseHeader(stripe, scanStart, heightOffset) ||
+            static_cast<uchar>(stripe[stripe.size() - 2]) != 0xFF ||
+            static_cast<uchar>(stripe[stripe.size() - 1]) != 0xD9) {
+            qWarning() << "JpegStripeEncoder: Malformed stripe" << i;
+            return false;
+        }
+
+        // Only the last stripe may be shorter than one restart interval
+        const int rows = readUInt16(stripe, heightOffset);
+        if (i < stripes.size() - 1 && rows != m_stripeRows) {
+            qWarning() << "JpegStripeEncoder: Stripe" << i << "has" << rows << "rows, expected" << m_stripeRows;
+            return false;
+        }
+        totalRows += rows;
+
+        if (i == 0) {
+            // Headers (tables, SOF, DRI, SOS) come from the first stripe
+            jpeg.append(stripe.constData(), scanStart);
+            heightField = heightOffset;
+        } else {
+            jpeg.append(static_cast<char>(0xFF));
+            jpeg.append(static_cast<char>(0xD0 + ((i - 1) % 8)));
+        }
+
+        // Entropy-coded data without the stripe's EOI marker
+        jpeg.append(stripe.constData() + scanStart, stripe.size() - scanStart - 2);
+    }
+
+    if (totalRows > 65535) {
+        qWarning() << "JpegStripeEncoder: Image too tall for baseline JPEG:" << totalRows;
+        return false;
+    }
+
+    jpeg.append(static_cast<char>(0xFF));
+    jpeg.append(static_cast<char>(0xD9));
+
+    jpeg[heightField] = static_cast<char>(totalRows >> 8);
+    jpeg[heightField + 1] = static_cast<char>(totalRows & 0xFF);
+    return true;
+}
+
+bool JpegStripeEncoder::encode(const cv::Mat& image, QByteArray& jpeg, QThreadPool* pool) const {
+    if (!isValid() || image.empty()) {
+        return false;
+    }
+
+    // Stripes are independent, so every thread takes some; each reads its rows
+    // straight from the image and the calling thread joins in while waiting
+    const int stripeCount = (image.rows + m_stripeRows - 1) / m_stripeRows;
+    QList<QByteArray> stripes(stripeCount);
+    QList<int> indices(stripeCount);
+    std::iota(indices.begin(), indices.end(), 0);
+
+    QByteArray* results = stripes.data();   // detached once, before the threads start
+
+    std::atomic<bool> ok(true);
+    QtConcurrent::blockingMap(pool, indices, [&](int i) {
+        const int y = i * m_stripeRows;
+        if (ok && !encodeStripe(image.rowRange(y, std::min(image.rows, y + m_stripeRows)), results[i])) {
+            ok = false;
+        }
+    });
+
+    return ok && stitch(stripes, jpeg);
+}
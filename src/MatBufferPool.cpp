@@ -0,0 +1,130 @@
+#include "MatBufferPool.h"
+#include <QDebug>
+#include <QMutexLocker>
+
+namespace {
+// Buffers below this size are cheap to allocate and are not pooled
+constexpr size_t kMinPooledBytes = 1024 * 1024;
+}
+
+void MatBufferPool::install(size_t maxIdleBytes) {
+    // Never deleted: Mats held by statics and late threads may free into it
+    static MatBufferPool* pool = new MatBufferPool(maxIdleBytes);
+    cv::Mat::setDefaultAllocator(pool);
+    qInfo() << "MatBufferPool: Keeping up to" << maxIdleBytes / (1024 * 1024) << "MB of image buffers";
+}
+
+MatBufferPool::MatBufferPool(size_t maxIdleBytes)
+    : m_maxIdleBytes(maxIdleBytes)
+    , m_idleBytes(0)
+    , m_pooledBytes(0)
+{
+}
+
+size_t MatBufferPool::roundCapacity(size_t bytes) {
+    // Rounded up to a power-of-two step of 1/16 to 1/8 of the size, so sizes
+    // that differ by a few rows share buffers and at most 12.5% is wasted
+    size_t step = 1;
+    while (step <= bytes / 16) {
+        step <<= 1;
+    }
+    return (bytes + step - 1) / step * step;
+}
+
+uchar* MatBufferPool::takeBuffer(size_t bytes) const {
+    {
+        QMutexLocker locker(&m_mutex);
+        // Smallest free buffer that fits, unless it is more than a quarter too big
+        auto it = m_idle.lower_bound(bytes);
+        if (it != m_idle.end() && it->first <= bytes + bytes / 4) {
+            uchar* buffer = it->second;
+            m_idleBytes -= it->first;
+            m_idle.erase(it);
+            return buffer;
+        }
+    }
+
+    // The heap is only touched outside the lock
+    const size_t capacity = roundCapacity(bytes);
+    uchar* buffer = static_cast<uchar*>(cv::fastMalloc(capacity));
+
+    QMutexLocker locker(&m_mutex);
+    m_capacity[buffer] = capacity;
+    m_pooledBytes += capacity;
+    qDebug() << "MatBufferPool: New" << capacity / 1024 << "KB buffer," << m_capacity.size()
+             << "buffers," << m_pooledBytes / (1024 * 1024) << "MB in the pool";
+    return buffer;
+}
+
+bool MatBufferPool::returnBuffer(uchar* buffer) const {
+    QMutexLocker locker(&m_mutex);
+    auto it = m_capacity.find(buffer);
+    if (it == m_capacity.end()) {
+        return false;
+    }
+
+    const size_t capacity = it->second;
+    if (m_idleBytes + capacity <= m_maxIdleBytes) {
+        m_idle.emplace(capacity, buffer);
+        m_idleBytes += capacity;
+        return true;
+    }
+
+    // Pool full: this buffer goes back to the heap
+    m_capacity.erase(it);
+    m_pooledBytes -= capacity;
+    locker.unlock();
+    cv::fastFree(buffer);
+    return true;
+}
+
+cv::UMatData* MatBufferPool::allocate(int dims, const int* sizes, int type, void* data0, size_t* step,
+                                      cv::AccessFlag /*flags*/, cv::UMatUsageFlags /*usageFlags*/) const {
+    // Same layout rules as OpenCV's default allocator
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; i--) {
+        if (step) {
+            if (data0 && step[i] != CV_AUTOSTEP) {
+                CV_Assert(total <= step[i]);
+                total = step[i];
+            } else {
+                step[i] = total;
+            }
+        }
+        total *= sizes[i];
+    }
+
+    uchar* data = static_cast<uchar*>(data0);
+    if (!data) {
+        data = total >= kMinPooledBytes ? takeBuffer(total) : static_cast<uchar*>(cv::fastMalloc(total));
+    }
+
+    cv::UMatData* u = new cv::UMatData(this);
+    u->data = u->origdata = data;
+    u->size = total;
+    if (data0) {
+        u->flags |= cv::UMatData::USER_ALLOCATED;
+    }
+    return u;
+}
+
+bool MatBufferPool::allocate(cv::UMatData* u, cv::AccessFlag /*accessFlags*/,
+                             cv::UMatUsageFlags /*usageFlags*/) const {
+    return u != nullptr;
+}
+
+void MatBufferPool::deallocate(cv::UMatData* u) const {
+    if (!u) {
+        return;
+    }
+    CV_Assert(u->urefcount == 0);
+    CV_Assert(u->refcount == 0);
+
+    if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+        if (u->size < kMinPooledBytes || !returnBuffer(u->origdata)) {
+            cv::fastFree(u->origdata);
+        }
+        u->origdata = nullptr;
+    }
+    delete u;
+}
@@ -0,0 +1,65 @@
+#include "MediaProfile.h"
+#include <cmath>
+
+namespace {
+// Relative size difference still accepted when matching a preview
+constexpr double kMatchTolerance = 0.12;
+
+MediaProfile makeProfile(const QString& id, const QString& name, const QSizeF& sizeMm, int dpi,
+                         const QString& mode, const QSize& outputSize) {
+    MediaProfile profile;
+    profile.id = id;
+    profile.name = name;
+    profile.sizeMm = sizeMm;
+    profile.dpi = dpi;
+    profile.mode = mode;
+    profile.outputSize = outputSize;
+    return profile;
+}
+
+double sizeError(const QSizeF& a, const QSizeF& b) {
+    return std::max(std::abs(a.width() - b.width()) / b.width(),
+                    std::abs(a.height() - b.height()) / b.height());
+}
+}
+
+const char* const MediaProfileRegistry::AutoDetect = "auto";
+
+MediaProfileRegistry::MediaProfileRegistry(AppSettings* settings) {
+    // The photo strip keeps the configured scanner settings and full scan area
+    m_profiles.append(makeProfile("strip", "Photo Strip", QSizeF(), settings->scannerDpi,
+                                  settings->scannerMode, QSize()));
+
+    // Prints are reproduced at 300 dpi, so scanning finer only costs time
+    m_profiles.append(makeProfile("print4x6", "4x6 Print", QSizeF(101.6, 152.4), 300, "Color", QSize(1200, 1800)));
+    m_profiles.append(makeProfile("wallet", "Wallet Photo", QSizeF(63.5, 88.9), 300, "Color", QSize(750, 1050)));
+    m_profiles.append(makeProfile("idcard", "ID Card", QSizeF(85.6, 54.0), 300, "Color", QSize(1011, 638)));
+}
+
+MediaProfile MediaProfileRegistry::find(const QString& id) const {
+    for (const MediaProfile& profile : m_profiles) {
+        if (profile.id == id) {
+            return profile;
+        }
+    }
+    return MediaProfile();
+}
+
+MediaProfile MediaProfileRegistry::match(const QSizeF& photoMm) const {
+    MediaProfile best;
+    double bestError = kMatchTolerance;
+
+    for (const MediaProfile& profile : m_profiles) {
+        if (!profile.hasSize()) {
+            continue;
+        }
+
+        const double error = std::min(sizeError(photoMm, profile.sizeMm),
+                                      sizeError(photoMm, profile.sizeMm.transposed()));
+        if (error < bestError) {
+            bestError = error;
+            best = profile;
+        }
+    }
+    return best;
+}
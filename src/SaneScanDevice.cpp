@@ -0,0 +1,99 @@
+#include "SaneScanDevice.h"
+#include <QDebug>
+#include <mutex>
+
+namespace {
+std::mutex backendMutex;
+bool backendInitialized = false;
+}
+
+bool SaneScanDevice::initBackend() {
+    std::lock_guard<std::mutex> lock(backendMutex);
+    if (backendInitialized) {
+        return true;
+    }
+
+    SANE_Int version = 0;
+    SANE_Status status = sane_init(&version, nullptr);
+    if (status != SANE_STATUS_GOOD) {
+        qCritical() << "SANE initialization failed:" << sane_strstatus(status);
+        return false;
+    }
+
+    qInfo() << "SANE initialized, version"
+            << SANE_VERSION_MAJOR(version) << "." << SANE_VERSION_MINOR(version)
+            << "." << SANE_VERSION_BUILD(version);
+    backendInitialized = true;
+    return true;
+}
+
+void SaneScanDevice::exitBackend() {
+    std::lock_guard<std::mutex> lock(backendMutex);
+    if (backendInitialized) {
+        sane_exit();
+        backendInitialized = false;
+    }
+}
+
+SaneScanDevice::SaneScanDevice()
+    : m_handle(nullptr)
+{
+}
+
+SaneScanDevice::~SaneScanDevice() {
+    close();
+}
+
+SANE_Status SaneScanDevice::open(const QString& deviceName) {
+    close();
+
+    SANE_Handle handle = nullptr;
+    SANE_Status status = sane_open(deviceName.toUtf8().constData(), &handle);
+    if (status == SANE_STATUS_GOOD) {
+        std::lock_guard<std::mutex> lock(m_handleMutex);
+        m_handle = handle;
+    }
+    return status;
+}
+
+void SaneScanDevice::close() {
+    std::lock_guard<std::mutex> lock(m_handleMutex);
+    SANE_Handle handle = m_handle.exchange(nullptr);
+    if (handle) {
+        sane_close(handle);
+    }
+}
+
+bool SaneScanDevice::isOpen() const {
+    return m_handle != nullptr;
+}
+
+const SANE_Option_Descriptor* SaneScanDevice::optionDescriptor(SANE_Int option) {
+    return sane_get_option_descriptor(m_handle, option);
+}
+
+SANE_Status SaneScanDevice::controlOption(SANE_Int option, SANE_Action action, void* value, SANE_Int* info) {
+    return sane_control_option(m_handle, option, action, value, info);
+}
+
+SANE_Status SaneScanDevice::start() {
+    return sane_start(m_handle);
+}
+
+SANE_Status SaneScanDevice::getParameters(SANE_Parameters* params) {
+    return sane_get_parameters(m_handle, params);
+}
+
+SANE_Status SaneScanDevice::read(SANE_Byte* data, SANE_Int maxLength, SANE_Int* length) {
+    return sane_read(m_handle, data, maxLength, length);
+}
+
+void SaneScanDevice::cancel() {
+    // sane_cancel() may be called asynchronously to abort a blocking sane_read();
+    // the lock only keeps close() out, reads on the scan thread go on
+    std::lock_guard<std::mutex> lock(m_handleMutex);
+    SANE_Handle handle = m_handle;
+    if (handle) {
+        sane_cancel(handle);
+    }
+}
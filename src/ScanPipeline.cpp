@@ -0,0 +1,356 @@
+#include "ScanPipeline.h"
+#include <QFile>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+
+namespace {
+// Downsampling factor of the preview used to cross-check with AutoCrop
+constexpr int kPreviewScale = 8;
+// Margin added around the detected photo, same as AutoCrop
+constexpr int kMargin = 5;
+// Content rows needed before the crop columns are locked and encoding starts
+constexpr int kLockRows = 256;
+// Minimum dark pixels for a column to count as photo content
+constexpr int kMinColumnPixels = 16;
+}
+
+ScanPipeline::ScanPipeline(AppSettings* settings)
+    : m_settings(settings)
+    , m_width(0)
+    , m_channels(0)
+    , m_dpi(0)
+    , m_rowCount(0)
+    , m_pageComplete(false)
+    , m_valid(false)
+    , m_contentRows(0)
+    , m_topRow(-1)
+    , m_lastContentRow(-1)
+    , m_colourSeen(false)
+    , m_grayscale(false)
+    , m_left(0)
+    , m_right(0)
+    , m_encodeStartRow(0)
+    , m_nextEncodeRow(0)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+ScanPipeline::~ScanPipeline() {
+    m_pool.waitForDone();
+}
+
+void ScanPipeline::beginPage(int width, int channels, int dpi) {
+    m_pool.start([this, width, channels, dpi]() {
+        resetPage(width, channels, dpi);
+    });
+}
+
+void ScanPipeline::addRows(const cv::Mat& rows) {
+    m_pool.start([this, rows]() {
+        processBand(rows);
+    });
+}
+
+void ScanPipeline::endPage(bool completed) {
+    m_pool.start([this, completed]() {
+        m_pageComplete = completed;
+    });
+}
+
+void ScanPipeline::resetPage(int width, int channels, int dpi) {
+    m_width = width;
+    m_channels = channels;
+    m_dpi = dpi;
+    m_rowCount = 0;
+    m_pageComplete = false;
+    m_valid = (channels == 1 || channels == 3) && width > 0;
+    m_bands.clear();
+    m_previewBands.clear();
+
+    m_contentRows = 0;
+    m_topRow = -1;
+    m_lastContentRow = -1;
+    m_colourSeen = false;
+    m_grayscale = false;
+    m_columnCounts.assign(width, 0);
+    m_lockedCounts.clear();
+
+    m_left = 0;
+    m_right = 0;
+    m_encodeStartRow = 0;
+    m_nextEncodeRow = 0;
+    m_encoder.reset();
+    m_stripes.clear();
+}
+
+void ScanPipeline::processBand(const cv::Mat& rows) {
+    if (!m_valid || rows.empty() || rows.cols != m_width || rows.channels() != m_channels) {
+        m_valid = false;
+        return;
+    }
+
+    try {
+        const int firstRow = m_rowCount;
+        m_bands.append(Band{firstRow, rows});
+        m_rowCount += rows.rows;
+
+        // Downsampled copy for the final AutoCrop cross-check. Each band gets
+        // the preview rows that fall into it, so rounding does not add up
+        // over the page and the preview keeps the page's aspect ratio.
+        const int previewRows = m_rowCount / kPreviewScale - firstRow / kPreviewScale;
+        if (previewRows > 0) {
+            cv::Mat gray;
+            if (m_channels == 3) {
+                cv::cvtColor(rows, gray, cv::COLOR_BGR2GRAY);
+            } else {
+                gray = rows;
+            }
+            cv::Mat preview;
+            cv::resize(gray, preview, cv::Size(std::max(1, m_width / kPreviewScale), previewRows),
+                       0, 0, cv::INTER_AREA);
+            m_previewBands.push_back(preview);
+        }
+
+        // Photo content is what AutoCrop counts: pixels whose darkest channel
+        // is below the detection threshold
+        std::vector<int> rowCounts;
+        std::vector<int> columnCounts;
+        AutoCrop::darknessProfiles(rows, m_settings->cropDetectionThreshold, rowCounts, columnCounts);
+
+        // Row profile: top edge and last row with content
+        const int minRowPixels = std::max(3, m_width / 200);
+        for (int y = 0; y < rows.rows; y++) {
+            if (rowCounts[y] >= minRowPixels) {
+                if (m_topRow < 0) {
+                    m_topRow = firstRow + y;
+                }
+                m_lastContentRow = firstRow + y;
+                m_contentRows++;
+            }
+        }
+
+        // Column profile
+        for (int x = 0; x < m_width; x++) {
+            m_columnCounts[x] += columnCounts[x];
+        }
+
+        // Colour anywhere in the photo columns means the page is not black and white
+        if (m_channels == 3 && m_settings->grayscaleDetection && !m_colourSeen && (!m_encoder || m_grayscale)) {
+            const cv::Mat photoRows = m_encoder ? rows.colRange(m_left, m_right) : rows;
+            m_colourSeen = !m_autoCrop.isGrayscale(photoRows);
+        }
+
+        if (!m_encoder && m_contentRows >= kLockRows) {
+            lockColumns();
+        }
+
+        if (m_encoder) {
+            if (m_grayscale && m_colourSeen) {
+                qInfo() << "ScanPipeline: Colour found after grayscale encoding started";
+                m_valid = false;
+                return;
+            }
+            checkColumns();
+            // Rows above the last content row are inside the photo for sure
+            if (m_valid) {
+                encodeRows(m_lastContentRow + 1, false);
+            }
+        }
+    } catch (const cv::Exception& e) {
+        qWarning() << "ScanPipeline: OpenCV exception:" << e.what();
+        m_valid = false;
+    }
+}
+
+void ScanPipeline::lockColumns() {
+    const int minCount = std::max(kMinColumnPixels, m_contentRows / 50);
+
+    int left = -1;
+    int right = -1;
+    for (int x = 0; x < m_width; x++) {
+        if (m_columnCounts[x] >= minCount) {
+            if (left < 0) {
+                left = x;
+            }
+            right = x;
+        }
+    }
+
+    if (left < 0) {
+        return;
+    }
+
+    m_left = std::max(0, left - kMargin);
+    m_right = std::min(m_width, right + 1 + kMargin);
+    m_lockedCounts = m_columnCounts;
+
+    // Decided on the rows seen so far; later colour falls back to the full frame
+    m_grayscale = m_channels == 3 && m_settings->grayscaleDetection && !m_colourSeen;
+
+    m_encoder.reset(new JpegStripeEncoder(m_right - m_left, m_grayscale ? 1 : m_channels,
+                                          m_settings->jpegQuality, m_dpi));
+    if (!m_encoder->isValid()) {
+        m_valid = false;
+        return;
+    }
+
+    m_encodeStartRow = std::max(0, m_topRow - kMargin);
+    m_nextEncodeRow = m_encodeStartRow;
+    qInfo() << "ScanPipeline: Locked columns" << m_left << "-" << m_right
+            << "after" << m_rowCount << "rows" << (m_grayscale ? "(grayscale)" : "");
+}
+
+void ScanPipeline::checkColumns() {
+    // Content appearing outside the locked columns (skewed or wider photo)
+    // invalidates the stripes that are already encoded
+    for (int x = 0; x < m_width; x++) {
+        if (x >= m_left && x < m_right) {
+            continue;
+        }
+        if (m_columnCounts[x] - m_lockedCounts[x] >= kMinColumnPixels) {
+            qInfo() << "ScanPipeline: Content outside locked columns at x =" << x;
+            m_valid = false;
+            return;
+        }
+    }
+}
+
+bool ScanPipeline::encodeRows(int endRow, bool flush) {
+    const int stripeRows = m_encoder->stripeRows();
+
+    while (m_nextEncodeRow + stripeRows <= endRow || (flush && m_nextEncodeRow < endRow)) {
+        const int lastRow = std::min(endRow, m_nextEncodeRow + stripeRows);
+
+        cv::Mat rows = copyRows(m_nextEncodeRow, lastRow);
+        if (m_grayscale) {
+            cv::cvtColor(rows, rows, cv::COLOR_BGR2GRAY);
+        }
+
+        QByteArray stripe;
+        if (!m_encoder->encodeStripe(rows, stripe)) {
+            m_valid = false;
+            return false;
+        }
+
+        m_stripes.append(stripe);
+        m_nextEncodeRow = lastRow;
+    }
+
+    return true;
+}
+
+cv::Mat ScanPipeline::copyRows(int firstRow, int lastRow) const {
+    cv::Mat out(lastRow - firstRow, m_right - m_left, CV_8UC(m_channels));
+
+    for (const Band& band : m_bands) {
+        const int bandEnd = band.firstRow + band.rows.rows;
+        if (bandEnd <= firstRow || band.firstRow >= lastRow) {
+            continue;
+        }
+
+        const int from = std::max(firstRow, band.firstRow);
+        const int to = std::min(lastRow, bandEnd);
+        band.rows(cv::Range(from - band.firstRow, to - band.firstRow), cv::Range(m_left, m_right))
+            .copyTo(out.rowRange(from - firstRow, to - firstRow));
+    }
+
+    return out;
+}
+
+bool ScanPipeline::matchesPreview(const QRect& cropRect) {
+    if (m_previewBands.empty()) {
+        return true;
+    }
+    cv::Mat preview;
+    cv::vconcat(m_previewBands, preview);
+
+    AutoCrop::CropResult coarse = m_autoCrop.detectPhotoBounds(preview, m_settings->cropDetectionThreshold);
+    if (!coarse.success || coarse.cropRect == QRect(0, 0, preview.cols, preview.rows)) {
+        // AutoCrop found nothing better than the whole page, no objection
+        return true;
+    }
+
+    // Stripes are axis-aligned; a skewed photo is straightened from the full frame
+    if (m_settings->deskew && AutoCrop::needsDeskew(coarse.angle)) {
+        qInfo() << "ScanPipeline: Photo is skewed by" << coarse.angle << "degrees";
+        return false;
+    }
+
+    // The streamed crop must keep everything the contour detector would keep
+    const double scaleX = static_cast<double>(m_width) / preview.cols;
+    const double scaleY = static_cast<double>(m_rowCount) / preview.rows;
+    const int tolerance = 2 * kPreviewScale;
+
+    QRect scaled(static_cast<int>(coarse.cropRect.x() * scaleX),
+                 static_cast<int>(coarse.cropRect.y() * scaleY),
+                 static_cast<int>(coarse.cropRect.width() * scaleX),
+                 static_cast<int>(coarse.cropRect.height() * scaleY));
+
+    return cropRect.adjusted(-tolerance, -tolerance, tolerance, tolerance).contains(scaled);
+}
+
+bool ScanPipeline::finish(const QString& outputPath) {
+    m_pool.waitForDone();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!m_pageComplete || !m_valid || m_topRow < 0) {
+        qInfo() << "ScanPipeline: No usable streamed result";
+        return false;
+    }
+
+    try {
+        // Short photos may end before the columns were locked
+        if (!m_encoder) {
+            lockColumns();
+            if (!m_encoder || !m_valid) {
+                return false;
+            }
+        }
+
+        const int stripesDuringScan = m_stripes.size();
+        const int bottomRow = std::min(m_rowCount, m_lastContentRow + 1 + kMargin);
+        if (!encodeRows(bottomRow, true)) {
+            return false;
+        }
+
+        QRect cropRect(m_left, m_encodeStartRow, m_right - m_left, bottomRow - m_encodeStartRow);
+
+        // Same sanity check as AutoCrop: reject tiny detections
+        if (static_cast<double>(cropRect.width()) * cropRect.height() <
+            0.1 * static_cast<double>(m_width) * m_rowCount) {
+            qInfo() << "ScanPipeline: Detected area too small:" << cropRect;
+            return false;
+        }
+
+        if (!matchesPreview(cropRect)) {
+            qInfo() << "ScanPipeline: Streamed crop disagrees with AutoCrop preview:" << cropRect;
+            return false;
+        }
+
+        QByteArray jpeg;
+        if (!m_encoder->stitch(m_stripes, jpeg)) {
+            return false;
+        }
+
+        QFile file(outputPath);
+        if (!file.open(QIODevice::WriteOnly) || file.write(jpeg) != jpeg.size()) {
+            qCritical() << "ScanPipeline: Failed to write JPEG:" << outputPath;
+            return false;
+        }
+        file.close();
+
+        m_cropRect = cropRect;
+        qInfo() << "ScanPipeline: Streamed crop" << cropRect << "-" << stripesDuringScan << "of"
+                << m_stripes.size() << "stripes encoded during scan, finished in"
+                << timer.elapsed() << "ms";
+        return true;
+
+    } catch (const cv::Exception& e) {
+        qWarning() << "ScanPipeline: OpenCV exception:" << e.what();
+        return false;
+    }
+}
@@ -1,204 +1,517 @@
 #include "ScannerManager.h"
-#include <QFile>
-#include <QTextStream>
-#include <QRegularExpression>
+#include <QSettings>
 #include <QDebug>
-#include <QImage>
-#include <QPainter>
+#include <algorithm>
+
+namespace {
+// Persisted names of the scanners that were found last
+const char* const kCachedDeviceKey = "scanner/lastDevice";
+// USB devices need a moment after the uevent before the backend can open them
+constexpr int kRediscoveryDelayMs = 2000;
+const char* const kDemoDeviceName = "demo-scanner (mock)";
+}
 
 ScannerManager::ScannerManager(AppSettings* settings, QObject* parent)
     : QObject(parent)
     , m_settings(settings)
-    , m_deviceName("")
-    , m_scanProcess(nullptr)
+    , m_profiles(settings)
+    , m_mediaProfile(MediaProfileRegistry::AutoDetect)
+    , m_hotplugMonitor(new UsbHotplugMonitor(this))
+    , m_rediscoveryTimer(new QTimer(this))
+    , m_discovering(false)
+    , m_discoveryPending(false)
+    , m_reinitializePending(false)
+    , m_scanning(false)
+    , m_batchQueued(false)
+    , m_documentMissing(false)
+    , m_lastProgress(0)
+    , m_pagesScanned(0)
 {
+    qRegisterMetaType<ScanFrame>("ScanFrame");
+
+    m_discoveryPool.setMaxThreadCount(1);
+    // Feeders take no preview to detect the media from
+    QString profileId = settings->mediaProfile;
+    if (profileId == MediaProfileRegistry::AutoDetect && !canDetectMedia()) {
+        profileId = m_profiles.defaultProfile().id;
+        qInfo() << "Media auto-detection needs the flatbed preview, scanning as"
+                << m_profiles.defaultProfile().name << "- set MEDIA_PROFILE to choose another";
+    }
+    if (!setMediaProfile(profileId) && !canDetectMedia()) {
+        m_mediaProfile = m_profiles.defaultProfile().id;
+    }
+
+    if (settings->previewScan && settings->isSheetFed()) {
+        qInfo() << "Preview scan is enabled but" << settings->scanSource()
+                << "is a feeder; pages are scanned without a preview";
+    }
+
+    // Plugging a scanner in (or back in) triggers a fresh discovery
+    m_rediscoveryTimer->setSingleShot(true);
+    m_rediscoveryTimer->setInterval(kRediscoveryDelayMs);
+    connect(m_rediscoveryTimer, &QTimer::timeout, this, [this]() {
+        startDiscovery(true);
+    });
+    connect(m_hotplugMonitor, &UsbHotplugMonitor::usbDeviceChanged,
+            this, &ScannerManager::scheduleRediscovery);
 }
 
 ScannerManager::~ScannerManager() {
-    if (m_scanProcess) {
-        m_scanProcess->kill();
-        m_scanProcess->waitForFinished();
-        delete m_scanProcess;
+    cancelScan();
+    m_discoveryPool.waitForDone();
+
+    // Workers close their devices before the SANE session ends
+    qDeleteAll(m_workers);
+    m_workers.clear();
+    SaneScanDevice::exitBackend();
+}
+
+QStringList ScannerManager::enumerateDevices(bool reinitialize) {
+    QStringList devices;
+
+    // The simulator stands in for real hardware, SANE is not touched at all
+    if (m_settings->simulatedScanner) {
+        for (int i = 0; i < std::max(1, m_settings->simScannerCount); i++) {
+            const QString name = SimulatedScanDevice::deviceName(i);
+            qInfo() << "Found scanner:" << name << "- simulated";
+            devices.append(name);
+        }
+        return devices;
+    }
+
+    // Some backends only probe the bus in sane_init(), so a hotplugged
+    // device is only seen after restarting the SANE session
+    if (reinitialize) {
+        SaneScanDevice::exitBackend();
+    }
+
+    if (!SaneScanDevice::initBackend()) {
+        return devices;
+    }
+
+    const SANE_Device** deviceList = nullptr;
+    SANE_Status status = sane_get_devices(&deviceList, SANE_FALSE);
+    if (status != SANE_STATUS_GOOD || !deviceList) {
+        qWarning() << "SANE device enumeration failed:" << sane_strstatus(status);
+        return devices;
     }
+
+    for (int i = 0; deviceList[i]; i++) {
+        const SANE_Device* device = deviceList[i];
+        qInfo() << "Found scanner:" << device->name << "-" << device->vendor << device->model;
+        devices.append(QString::fromUtf8(device->name));
+    }
+
+    return devices;
 }
 
-bool ScannerManager::detectScanner() {
+void ScannerManager::detectScanner() {
     // Demo mode: always succeed
     if (m_settings->demoMode) {
-        m_deviceName = "demo-scanner (mock)";
         qInfo() << "DEMO MODE: Mock scanner detected";
-        emit scannerDetected(m_deviceName);
-        return true;
+        setDevices({QString::fromLatin1(kDemoDeviceName)});
+        return;
     }
 
-    qInfo() << "Detecting scanner...";
+    if (!m_hotplugMonitor->isRunning()) {
+        m_hotplugMonitor->start();
+    }
 
-    QProcess process;
-    process.start("scanimage", QStringList() << "-L");
+    // Use the last known devices right away and only check them in the
+    // background; a full enumeration can take several seconds
+    const QStringList cachedDevices = QSettings().value(kCachedDeviceKey).toStringList();
+    if (cachedDevices.isEmpty() || m_settings->simulatedScanner) {
+        startDiscovery(false);
+        return;
+    }
 
-    if (!process.waitForFinished(10000)) {
-        qWarning() << "Scanner detection timeout";
-        emit scannerNotFound();
-        return false;
+    qInfo() << "Using cached scanners:" << cachedDevices;
+    setDevices(cachedDevices);
+
+    // A missing device triggers a full discovery through deviceUnavailable()
+    for (ScannerWorker* worker : m_workers) {
+        worker->probe();
+    }
+}
+
+void ScannerManager::startDiscovery(bool reinitialize) {
+    if (m_discovering || m_scanning) {
+        m_discoveryPending = true;
+        m_reinitializePending = m_reinitializePending || reinitialize;
+        return;
     }
 
-    QString output = process.readAllStandardOutput() + process.readAllStandardError();
+    qInfo() << "Detecting scanners...";
+    m_discovering = true;
+    m_discoveryPending = false;
+    m_reinitializePending = false;
+
+    const QList<ScannerWorker*> workers = m_workers;
+    m_discoveryPool.start([this, reinitialize, workers]() {
+        if (reinitialize) {
+            // No handle may stay open across sane_exit()
+            for (ScannerWorker* worker : workers) {
+                worker->releaseDevice();
+            }
+        }
+
+        QStringList devices = enumerateDevices(reinitialize);
+        QMetaObject::invokeMethod(this, [this, devices]() {
+            onDevicesDiscovered(devices);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ScannerManager::onDevicesDiscovered(const QStringList& devices) {
+    m_discovering = false;
+    m_availableDevices = devices;
 
-    // Check for no scanners
-    if (output.contains("No scanners were identified")) {
+    if (devices.isEmpty()) {
         qWarning() << "No scanners detected";
-        emit scannerNotFound();
-        return false;
+        setDevices({});
+    } else {
+        setDevices(selectDevices(devices));
     }
 
-    // Look for Fujitsu fi-800R (uses fujitsu or epsonds backend)
-    // Example: "device `fujitsu:ScanSnap fi-800R:xxxxx' is a FUJITSU fi-800R scanner"
-    QRegularExpression devicePattern("device `([^']+)'");
-    QRegularExpressionMatchIterator it = devicePattern.globalMatch(output);
+    if (m_batchQueued) {
+        dispatchBatch();
+    } else if (m_discoveryPending) {
+        startDiscovery(m_reinitializePending);
+    }
+}
+
+QStringList ScannerManager::selectDevices(const QStringList& devices) const {
+    const int maxScanners = std::max(1, m_settings->maxScanners);
+    QStringList selected;
 
-    // First pass: look for Fujitsu scanners specifically
-    QStringList allDevices;
-    while (it.hasNext()) {
-        QRegularExpressionMatch match = it.next();
-        QString device = match.captured(1);
-        allDevices.append(device);
+    // Keep the current devices while they are still connected
+    for (const ScannerWorker* worker : m_workers) {
+        if (devices.contains(worker->deviceName()) && selected.size() < maxScanners) {
+            selected.append(worker->deviceName());
+        }
+    }
 
+    // Look for Fujitsu fi-800R (uses fujitsu or epsonds backend)
+    // Example: "fujitsu:ScanSnap fi-800R:xxxxx"
+    for (const QString& device : devices) {
+        if (selected.size() >= maxScanners) {
+            break;
+        }
         // Prefer fujitsu backend for fi-800R
-        if (device.contains("fujitsu", Qt::CaseInsensitive) ||
-            device.contains("fi-800", Qt::CaseInsensitive)) {
-            m_deviceName = device;
-            m_settings->scannerDevice = device;
-            qInfo() << "Scanner detected:" << m_deviceName;
-            emit scannerDetected(m_deviceName);
-            return true;
+        if (!selected.contains(device) &&
+            (device.contains("fujitsu", Qt::CaseInsensitive) ||
+             device.contains("fi-800", Qt::CaseInsensitive) ||
+             SimulatedScanDevice::isSimulated(device))) {
+            selected.append(device);
         }
     }
 
     // Fall back to first available scanner
-    if (!allDevices.isEmpty()) {
-        m_deviceName = allDevices.first();
-        m_settings->scannerDevice = m_deviceName;
-        qInfo() << "Generic scanner detected:" << m_deviceName;
-        emit scannerDetected(m_deviceName);
-        return true;
+    if (selected.isEmpty()) {
+        qInfo() << "Using generic scanner";
+        selected.append(devices.first());
+    }
+
+    return selected;
+}
+
+void ScannerManager::setDevices(const QStringList& deviceNames) {
+    QStringList current;
+    for (ScannerWorker* worker : m_workers) {
+        current.append(worker->deviceName());
+    }
+
+    if (current != deviceNames) {
+        // Devices that disappeared are dropped; their handles close with them
+        for (auto it = m_workers.begin(); it != m_workers.end();) {
+            if (!deviceNames.contains((*it)->deviceName())) {
+                qInfo() << "Scanner removed:" << (*it)->deviceName();
+                delete *it;
+                it = m_workers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        for (const QString& deviceName : deviceNames) {
+            if (!current.contains(deviceName)) {
+                m_workers.append(createWorker(deviceName));
+            }
+        }
+    }
+
+    if (m_workers.isEmpty()) {
+        m_settings->scannerDevice.clear();
+        emit scannerNotFound();
+        return;
+    }
+
+    m_settings->scannerDevice = deviceNames.first();
+    if (!m_settings->demoMode) {
+        QSettings().setValue(kCachedDeviceKey, deviceNames);
+    }
+
+    qInfo() << "Scanners detected:" << deviceNames;
+    emit scannerDetected(getDeviceName());
+}
+
+ScannerWorker* ScannerManager::createWorker(const QString& deviceName) {
+    ScannerWorker* worker = new ScannerWorker(m_settings, deviceName, this);
+
+    connect(worker, &ScannerWorker::scanCompleted, this, &ScannerManager::scanCompleted);
+    connect(worker, &ScannerWorker::scanProgress, this, &ScannerManager::onWorkerProgress);
+    connect(worker, &ScannerWorker::documentMissing, this, [this, worker]() {
+        m_waitingWorkers.insert(worker);
+        updateDocumentState();
+    });
+    connect(worker, &ScannerWorker::documentDetected, this, [this, worker]() {
+        m_waitingWorkers.remove(worker);
+        updateDocumentState();
+    });
+    connect(worker, &ScannerWorker::finished, this, [this, worker](int pagesScanned, const QString& errorMessage) {
+        onWorkerFinished(worker, pagesScanned, errorMessage);
+    });
+    connect(worker, &ScannerWorker::deviceUnavailable, this, [this]() {
+        // The device may have come back under a different USB address
+        startDiscovery(true);
+    });
+
+    return worker;
+}
+
+void ScannerManager::scheduleRediscovery() {
+    if (!m_settings->demoMode) {
+        m_rediscoveryTimer->start();
     }
+}
 
-    qWarning() << "No compatible scanner found";
-    emit scannerNotFound();
-    return false;
+bool ScannerManager::performScan(std::shared_ptr<ScanLineSink> sink) {
+    return performBatchScan(1, {sink});
 }
 
-bool ScannerManager::performScan(const QString& outputPath) {
-    if (m_deviceName.isEmpty()) {
+bool ScannerManager::performBatchScan(int pageCount, const QList<std::shared_ptr<ScanLineSink>>& sinks) {
+    if (pageCount < 1) {
+        qWarning() << "Cannot scan: Invalid page count" << pageCount;
+        return false;
+    }
+
+    if (m_workers.isEmpty() && !m_discovering) {
         qCritical() << "Cannot scan: No scanner device set";
         emit scanFailed("No scanner detected");
         return false;
     }
 
-    // Demo mode: create fake TIFF file
-    if (m_settings->demoMode) {
-        emit scanStarted();
-        qInfo() << "DEMO MODE: Mock scanning to" << outputPath;
-        createDemoScan(outputPath);
-        emit scanCompleted(outputPath);
-        return true;
+    if (m_scanning) {
+        qWarning() << "Cannot scan: A scan is already in progress";
+        return false;
     }
 
+    m_scanning = true;
+    const bool autoDetect = m_mediaProfile == MediaProfileRegistry::AutoDetect;
+    m_batch = std::make_shared<ScanBatch>(pageCount, sinks, currentProfile(),
+                                          autoDetect ? &m_profiles : nullptr);
+    m_batchWorkers.clear();
+    m_waitingWorkers.clear();
+    m_documentMissing = false;
+    m_pageProgress.fill(0, pageCount);
+    m_lastProgress = 0;
+    m_pagesScanned = 0;
+    m_batchError.clear();
+
     emit scanStarted();
-    qInfo() << "Starting scan to" << outputPath;
-
-    // Build scanimage command for Fujitsu fi-800R
-    QStringList args;
-    args << "--device-name" << m_deviceName;
-    args << "--source" << "Card Front";  // Use card feeder front side
-    args << "--format" << m_settings->scannerFormat;
-    args << "--resolution" << QString::number(m_settings->scannerDpi);
-    args << "--mode" << m_settings->scannerMode;
-
-    // Output to file
-    args << "-o" << outputPath;
-
-    m_scanProcess = new QProcess(this);
-    m_scanProcess->start("scanimage", args);
-
-    if (!m_scanProcess->waitForFinished(m_settings->scanTimeout * 1000)) {
-        qCritical() << "Scan timeout";
-        emit scanFailed("Scan timeout - please try again");
-        delete m_scanProcess;
-        m_scanProcess = nullptr;
-        return false;
+    emit scanProgress(0);
+
+    if (m_discovering) {
+        qInfo() << "Scan queued until scanner discovery completes";
+        m_batchQueued = true;
+        return true;
     }
 
-    if (m_scanProcess->exitCode() != 0) {
-        QString errorMsg = m_scanProcess->readAllStandardError();
-        qCritical() << "Scan failed:" << errorMsg;
-        emit scanFailed("Scanner error: " + errorMsg);
-        delete m_scanProcess;
-        m_scanProcess = nullptr;
-        return false;
+    dispatchBatch();
+    return true;
+}
+
+void ScannerManager::dispatchBatch() {
+    m_batchQueued = false;
+
+    // Every scanner takes part; each claims the next page when it is idle
+    for (ScannerWorker* worker : m_workers) {
+        if (worker->startBatch(m_batch)) {
+            m_batchWorkers.insert(worker);
+        }
     }
 
-    delete m_scanProcess;
-    m_scanProcess = nullptr;
+    if (m_batchWorkers.isEmpty()) {
+        m_batchError = "No scanner detected";
+        finishBatch();
+        return;
+    }
 
-    // Verify file was created and has content
-    QFile file(outputPath);
-    if (!file.exists() || file.size() == 0) {
-        qCritical() << "Scan produced no output";
-        emit scanFailed("Scanner produced empty file");
-        return false;
+    qInfo() << "Scanning" << m_batch->pageCount() << "page(s) on" << m_batchWorkers.size() << "scanner(s)";
+}
+
+void ScannerManager::onWorkerProgress(int page, int percentage) {
+    if (!m_scanning || page < 0 || page >= m_pageProgress.size()) {
+        return;
     }
 
-    qInfo() << "Scan completed successfully";
-    emit scanCompleted(outputPath);
-    return true;
+    m_pageProgress[page] = percentage;
+
+    int total = 0;
+    for (int progress : m_pageProgress) {
+        total += progress;
+    }
+    const int overall = std::min(99, total / m_pageProgress.size());
+    if (overall != m_lastProgress) {
+        m_lastProgress = overall;
+        emit scanProgress(overall);
+    }
 }
 
-bool ScannerManager::isAvailable() const {
-    return !m_deviceName.isEmpty();
+void ScannerManager::onWorkerFinished(ScannerWorker* worker, int pagesScanned, const QString& errorMessage) {
+    if (!m_batchWorkers.remove(worker)) {
+        return;
+    }
+    m_waitingWorkers.remove(worker);
+
+    m_pagesScanned += pagesScanned;
+    if (!errorMessage.isEmpty() && m_batchError.isEmpty()) {
+        m_batchError = errorMessage;
+    }
+
+    if (m_batchWorkers.isEmpty()) {
+        finishBatch();
+    } else {
+        updateDocumentState();
+    }
 }
 
-QString ScannerManager::getDeviceName() const {
-    return m_deviceName.isEmpty() ? "Not detected" : m_deviceName;
+void ScannerManager::finishBatch() {
+    // Every scanner found its feeder empty
+    if (m_pagesScanned == 0 && m_batchError.isEmpty() && m_batch && m_batch->hasPendingPages()) {
+        m_batchError = "No document in the feeder";
+    }
+
+    m_scanning = false;
+    m_batch.reset();
+    m_waitingWorkers.clear();
+    m_documentMissing = false;
+
+    // Pages from a scanner that worked count even if another one failed; the
+    // error still goes along so the customer learns why the rest stopped
+    if (m_pagesScanned > 0 || m_batchError.isEmpty()) {
+        if (m_batchError.isEmpty()) {
+            qInfo() << "Scan completed successfully:" << m_pagesScanned << "page(s)";
+        } else {
+            qWarning() << "Scan stopped after" << m_pagesScanned << "page(s):" << m_batchError;
+        }
+        emit scanProgress(100);
+        emit batchFinished(m_pagesScanned, m_batchError);
+    } else {
+        qCritical() << "Scan failed:" << m_batchError;
+        emit scanFailed(m_batchError);
+    }
+
+    if (m_discoveryPending) {
+        startDiscovery(m_reinitializePending);
+    }
+}
+
+void ScannerManager::updateDocumentState() {
+    // Only ask for a page when no scanner of the batch has one
+    const bool missing = !m_waitingWorkers.isEmpty() && m_waitingWorkers.size() == m_batchWorkers.size();
+    if (missing == m_documentMissing) {
+        return;
+    }
+
+    m_documentMissing = missing;
+    if (missing) {
+        emit documentMissing();
+    } else {
+        emit documentDetected();
+    }
+}
+
+void ScannerManager::warmUp() {
+    if (m_settings->demoMode || m_discovering || m_scanning) {
+        return;
+    }
+
+    const MediaProfile profile = currentProfile();
+    for (ScannerWorker* worker : m_workers) {
+        worker->warmUp(profile);
+    }
+}
+
+bool ScannerManager::setMediaProfile(const QString& profileId) {
+    if (profileId == MediaProfileRegistry::AutoDetect) {
+        if (!canDetectMedia()) {
+            qWarning() << "Media auto-detection is not available without a flatbed preview";
+            return false;
+        }
+    } else if (!m_profiles.find(profileId).isValid()) {
+        qWarning() << "Unknown media profile:" << profileId;
+        return false;
+    }
+
+    m_mediaProfile = profileId;
+    qInfo() << "Media profile:" << profileId;
+    return true;
 }
 
-QStringList ScannerManager::listAvailableScanners() {
-    QStringList scanners;
+bool ScannerManager::canDetectMedia() const {
+    // The media is measured in the preview, which feeders do not take
+    return m_settings->previewScan && m_settings->previewDpi > 0 && !m_settings->isSheetFed();
+}
 
-    QProcess process;
-    process.start("scanimage", QStringList() << "-L");
+MediaProfile ScannerManager::currentProfile() const {
+    // Auto-detection starts from the default profile until a preview says otherwise
+    const MediaProfile profile = m_profiles.find(m_mediaProfile);
+    return profile.isValid() ? profile : m_profiles.defaultProfile();
+}
 
-    if (!process.waitForFinished(10000)) {
-        return scanners;
+void ScannerManager::cancelScan() {
+    if (!m_scanning) {
+        return;
     }
 
-    QString output = process.readAllStandardOutput();
-    QRegularExpression devicePattern("device `([^']+)'");
-    QRegularExpressionMatchIterator it = devicePattern.globalMatch(output);
+    if (m_batchQueued) {
+        m_batchQueued = false;
+        m_batchError = "Scan cancelled";
+        finishBatch();
+        return;
+    }
 
-    while (it.hasNext()) {
-        QRegularExpressionMatch match = it.next();
-        scanners.append(match.captured(1));
+    for (ScannerWorker* worker : m_batchWorkers) {
+        worker->cancelScan();
     }
+}
 
-    return scanners;
+bool ScannerManager::isScanning() const {
+    return m_scanning;
 }
 
-void ScannerManager::createDemoScan(const QString& outputPath) {
-    // Create a fake scan (white image with colored rectangles to simulate photo strip)
-    QImage image(1725, 1988, QImage::Format_RGB888);
-    image.fill(Qt::white);
+bool ScannerManager::isAvailable() const {
+    return !m_workers.isEmpty();
+}
 
-    QPainter painter(&image);
+QString ScannerManager::getDeviceName() const {
+    if (m_workers.isEmpty()) {
+        return "Not detected";
+    }
 
-    // Add colored boxes to simulate photo strip
-    painter.fillRect(300, 200, 1125, 400, QColor(255, 200, 200)); // Pink
-    painter.fillRect(300, 700, 1125, 400, QColor(200, 255, 200)); // Green
-    painter.fillRect(300, 1200, 1125, 400, QColor(200, 200, 255)); // Blue
+    QStringList names;
+    for (const ScannerWorker* worker : m_workers) {
+        names.append(worker->deviceName());
+    }
+    return names.join(", ");
+}
 
-    painter.end();
+int ScannerManager::scannerCount() const {
+    return m_workers.size();
+}
 
-    // Save as TIFF
-    image.save(outputPath, "TIFF");
-    qInfo() << "DEMO MODE: Mock scan completed";
+QStringList ScannerManager::listAvailableScanners() const {
+    // Result of the last background discovery
+    return m_availableDevices;
 }
@@ -0,0 +1,977 @@
+#include "ScannerWorker.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QUuid>
+#include <QThread>
+#include <QtConcurrent>
+#include <QDebug>
+#include <sane/saneopts.h>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "SystemMemory.h"
+
+namespace {
+// Upper bound for a single sane_read() call
+constexpr size_t kReadChunkBytes = 256 * 1024;
+// Scanlines handed to the streaming sink at a time
+constexpr int kBandLines = 64;
+// Border kept around the photo found in the preview, so AutoCrop still sees its edges
+constexpr double kPreviewMarginMm = 3.0;
+constexpr double kMmPerInch = 25.4;
+// Scanner-side compression options of the fujitsu backend
+const char* const kCompressionOption = "compression";
+const char* const kCompressionLevelOption = "compression-arg";
+// Paper sensors reported by the fujitsu backend (and the simulator)
+const char* const kPaperSensors[] = {"page-loaded", "card-loaded"};
+constexpr int kSensorPollMs = 200;
+}
+
+ScannerWorker::ScannerWorker(AppSettings* settings, const QString& deviceName, QObject* parent)
+    : QObject(parent)
+    , m_settings(settings)
+    , m_deviceName(deviceName)
+    , m_scanWatchdog(new QTimer(this))
+    , m_simulatedDevice(settings)
+    , m_device(nullptr)
+    , m_scanning(false)
+    , m_cancelRequested(false)
+    , m_timedOut(false)
+    , m_warmingUp(false)
+    , m_lastStatus(SANE_STATUS_GOOD)
+    , m_page(0)
+    , m_side(0)
+    , m_sides(1)
+{
+    // A single long-lived thread owns the device so scans never block the GUI
+    m_scanPool.setMaxThreadCount(1);
+    m_scanPool.setExpiryTimeout(-1);
+
+    // sane_read() can block indefinitely, so the timeout is enforced from the GUI thread
+    m_scanWatchdog->setSingleShot(true);
+    connect(m_scanWatchdog, &QTimer::timeout, this, &ScannerWorker::onScanTimeout);
+    // Each page of a batch gets the full timeout
+    connect(this, &ScannerWorker::scanCompleted, this, [this]() {
+        if (m_scanning) {
+            m_scanWatchdog->start(m_settings->scanTimeout * 1000);
+        }
+    });
+    connect(this, &ScannerWorker::finished, m_scanWatchdog, &QTimer::stop);
+
+    // Waiting for the customer to insert a page does not count towards the timeout
+    connect(this, &ScannerWorker::documentMissing, m_scanWatchdog, &QTimer::stop);
+    connect(this, &ScannerWorker::documentDetected, this, [this]() {
+        m_scanWatchdog->start(m_settings->scanTimeout * 1000);
+    });
+}
+
+ScannerWorker::~ScannerWorker() {
+    cancelScan();
+    m_scanFuture.waitForFinished();
+    releaseDevice();
+}
+
+void ScannerWorker::probe() {
+    m_scanPool.start([this]() {
+        QString errorMessage;
+        if (openDevice(errorMessage)) {
+            qInfo() << "Cached scanner confirmed:" << m_deviceName;
+            return;
+        }
+
+        qWarning() << "Cached scanner not available:" << errorMessage;
+        emit deviceUnavailable();
+    });
+}
+
+void ScannerWorker::releaseDevice() {
+    QtConcurrent::run(&m_scanPool, [this]() {
+        closeDevice();
+    }).waitForFinished();
+}
+
+bool ScannerWorker::startBatch(std::shared_ptr<ScanBatch> batch) {
+    if (m_scanning) {
+        qWarning() << m_deviceName << "is already scanning";
+        return false;
+    }
+
+    m_scanning = true;
+    m_cancelRequested = false;
+    m_timedOut = false;
+
+    // Run the scan on the scan thread; results arrive through queued signals
+    m_scanWatchdog->start(m_settings->scanTimeout * 1000);
+    m_scanFuture = QtConcurrent::run(&m_scanPool, [this, batch]() {
+        scanTask(batch);
+    });
+    return true;
+}
+
+bool ScannerWorker::isScanning() const {
+    return m_scanning;
+}
+
+bool ScannerWorker::openDevice(QString& errorMessage) {
+    if (m_device) {
+        return true;
+    }
+
+    ScanDevice* device = &m_simulatedDevice;
+    if (!SimulatedScanDevice::isSimulated(m_deviceName)) {
+        if (!SaneScanDevice::initBackend()) {
+            errorMessage = "Scanner subsystem unavailable";
+            return false;
+        }
+        device = &m_saneDevice;
+    }
+
+    SANE_Status status = device->open(m_deviceName);
+    if (status != SANE_STATUS_GOOD) {
+        errorMessage = QString("Cannot open scanner: %1").arg(sane_strstatus(status));
+        qCritical() << "Opening" << m_deviceName << "failed:" << sane_strstatus(status);
+        return false;
+    }
+
+    m_device = device;
+    loadOptionIndex();
+    qInfo() << "Scanner opened:" << m_deviceName << "(" << m_optionIndex.size() << "options)";
+    return true;
+}
+
+void ScannerWorker::closeDevice() {
+    if (m_device) {
+        m_device->close();
+        m_device = nullptr;
+        m_optionIndex.clear();
+        qInfo() << "Scanner closed:" << m_deviceName;
+    }
+}
+
+void ScannerWorker::loadOptionIndex() {
+    m_optionIndex.clear();
+
+    // Option 0 always holds the number of options
+    SANE_Int optionCount = 0;
+    if (m_device->controlOption(0, SANE_ACTION_GET_VALUE, &optionCount, nullptr) != SANE_STATUS_GOOD) {
+        qWarning() << "Failed to read scanner option count";
+        return;
+    }
+
+    for (SANE_Int i = 1; i < optionCount; i++) {
+        const SANE_Option_Descriptor* desc = m_device->optionDescriptor(i);
+        if (desc && desc->name && desc->name[0] != '\0') {
+            m_optionIndex.insert(QString::fromLatin1(desc->name), i);
+        }
+    }
+}
+
+bool ScannerWorker::setOption(const QString& name, const QVariant& value) {
+    auto it = m_optionIndex.constFind(name);
+    if (it == m_optionIndex.constEnd()) {
+        qWarning() << "Scanner option not supported:" << name;
+        return false;
+    }
+
+    const SANE_Int index = it.value();
+    const SANE_Option_Descriptor* desc = m_device->optionDescriptor(index);
+    if (!desc || !SANE_OPTION_IS_ACTIVE(desc->cap) || !SANE_OPTION_IS_SETTABLE(desc->cap)) {
+        qWarning() << "Scanner option not settable:" << name;
+        return false;
+    }
+
+    SANE_Status status = SANE_STATUS_UNSUPPORTED;
+    SANE_Int info = 0;
+
+    switch (desc->type) {
+    case SANE_TYPE_BOOL: {
+        SANE_Bool v = value.toBool() ? SANE_TRUE : SANE_FALSE;
+        status = m_device->controlOption(index, SANE_ACTION_SET_VALUE, &v, &info);
+        break;
+    }
+    case SANE_TYPE_INT: {
+        SANE_Int v = value.toInt();
+        status = m_device->controlOption(index, SANE_ACTION_SET_VALUE, &v, &info);
+        break;
+    }
+    case SANE_TYPE_FIXED: {
+        SANE_Fixed v = SANE_FIX(value.toDouble());
+        status = m_device->controlOption(index, SANE_ACTION_SET_VALUE, &v, &info);
+        break;
+    }
+    case SANE_TYPE_STRING: {
+        // String options must be passed in a buffer of the descriptor's size
+        QByteArray utf8 = value.toString().toUtf8();
+        std::vector<char> buffer(std::max<size_t>(desc->size, utf8.size() + 1), '\0');
+        std::memcpy(buffer.data(), utf8.constData(), utf8.size());
+        status = m_device->controlOption(index, SANE_ACTION_SET_VALUE, buffer.data(), &info);
+        break;
+    }
+    default:
+        break;
+    }
+
+    if (status != SANE_STATUS_GOOD) {
+        qWarning() << "Failed to set scanner option" << name << "=" << value << ":" << sane_strstatus(status);
+        return false;
+    }
+
+    if (info & SANE_INFO_RELOAD_OPTIONS) {
+        loadOptionIndex();
+    }
+    return true;
+}
+
+bool ScannerWorker::applyScanOptions(const MediaProfile& profile, QString& errorMessage) {
+    // Use card feeder front side (or duplex) on the Fujitsu fi-800R
+    if (!setOption(SANE_NAME_SCAN_SOURCE, scanSource())) {
+        qWarning() << "Using the scanner's default source";
+    }
+
+    if (!setOption(SANE_NAME_SCAN_MODE, profile.mode)) {
+        errorMessage = QString("Scanner does not support mode: %1").arg(profile.mode);
+        return false;
+    }
+
+    if (!setOption(SANE_NAME_SCAN_RESOLUTION, profile.dpi)) {
+        errorMessage = QString("Scanner does not support %1 dpi").arg(profile.dpi);
+        return false;
+    }
+
+    // Scanner-side JPEG cuts the USB transfer and is cropped without re-encoding
+    if (m_optionIndex.contains(kCompressionOption)) {
+        const bool jpeg = m_settings->scannerJpeg && profile.mode != "Lineart";
+        if (setOption(kCompressionOption, jpeg ? "JPEG" : "None") && jpeg &&
+            m_optionIndex.contains(kCompressionLevelOption)) {
+            // Levels 1 (smallest) to 7 (best quality)
+            const int level = std::clamp((m_settings->jpegQuality * 7 + 50) / 100, 1, 7);
+            setOption(kCompressionLevelOption, level);
+        }
+    }
+
+    return true;
+}
+
+bool ScannerWorker::optionRange(const QString& name, double& minValue, double& maxValue) {
+    auto it = m_optionIndex.constFind(name);
+    if (it == m_optionIndex.constEnd()) {
+        return false;
+    }
+
+    const SANE_Option_Descriptor* desc = m_device->optionDescriptor(it.value());
+    if (!desc || !SANE_OPTION_IS_ACTIVE(desc->cap) || desc->unit != SANE_UNIT_MM ||
+        desc->constraint_type != SANE_CONSTRAINT_RANGE || !desc->constraint.range) {
+        return false;
+    }
+
+    const SANE_Range* range = desc->constraint.range;
+    if (desc->type == SANE_TYPE_FIXED) {
+        minValue = SANE_UNFIX(range->min);
+        maxValue = SANE_UNFIX(range->max);
+    } else if (desc->type == SANE_TYPE_INT) {
+        minValue = range->min;
+        maxValue = range->max;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool ScannerWorker::setScanArea(const QRectF& areaMm) {
+    // Top-left first: starting from the full area keeps tl < br at every step
+    return setOption(SANE_NAME_SCAN_TL_X, areaMm.left()) &&
+           setOption(SANE_NAME_SCAN_TL_Y, areaMm.top()) &&
+           setOption(SANE_NAME_SCAN_BR_X, areaMm.right()) &&
+           setOption(SANE_NAME_SCAN_BR_Y, areaMm.bottom());
+}
+
+QString ScannerWorker::scanSource() const {
+    return m_settings->scanSource();
+}
+
+bool ScannerWorker::isSheetFed() const {
+    return m_settings->isSheetFed();
+}
+
+bool ScannerWorker::readSensor(const QString& name, bool& value) {
+    auto it = m_optionIndex.constFind(name);
+    if (it == m_optionIndex.constEnd()) {
+        return false;
+    }
+
+    const SANE_Option_Descriptor* desc = m_device->optionDescriptor(it.value());
+    if (!desc || desc->type != SANE_TYPE_BOOL || !SANE_OPTION_IS_ACTIVE(desc->cap)) {
+        return false;
+    }
+
+    SANE_Bool state = SANE_FALSE;
+    if (m_device->controlOption(it.value(), SANE_ACTION_GET_VALUE, &state, nullptr) != SANE_STATUS_GOOD) {
+        return false;
+    }
+
+    value = (state == SANE_TRUE);
+    return true;
+}
+
+bool ScannerWorker::waitForDocument(const ScanBatch& batch, QString& errorMessage) {
+    if (!isSheetFed()) {
+        return true;
+    }
+
+    // Without a paper sensor the scan just starts, as before
+    QString sensor;
+    bool loaded = false;
+    for (const char* name : kPaperSensors) {
+        if (readSensor(name, loaded)) {
+            sensor = name;
+            break;
+        }
+    }
+    if (sensor.isEmpty() || loaded) {
+        return true;
+    }
+
+    // Nothing in the feeder: tell the customer right away instead of waiting
+    // for sane_start() to fail, and start as soon as the sensor sees a page
+    qInfo() << "No document in the feeder, waiting for" << sensor;
+    emit documentMissing();
+
+    while (!m_cancelRequested) {
+        QThread::msleep(kSensorPollMs);
+        // The other scanners may have taken all pages meanwhile
+        if (!batch.hasPendingPages()) {
+            qInfo() << m_deviceName << "no longer needed for this batch";
+            return true;
+        }
+        if (!readSensor(sensor, loaded) || loaded) {
+            qInfo() << "Document inserted, starting scan";
+            emit documentDetected();
+            return true;
+        }
+    }
+
+    errorMessage = describeStatus(SANE_STATUS_CANCELLED);
+    return false;
+}
+
+bool ScannerWorker::selectScanArea(MediaProfile& profile, const MediaProfileRegistry* detectFrom,
+                                   QString& errorMessage) {
+    // Full scan area in mm; without geometry options the scanner always uses it
+    double left = 0, top = 0, right = 0, bottom = 0, unused = 0;
+    if (!optionRange(SANE_NAME_SCAN_TL_X, left, unused) ||
+        !optionRange(SANE_NAME_SCAN_TL_Y, top, unused) ||
+        !optionRange(SANE_NAME_SCAN_BR_X, unused, right) ||
+        !optionRange(SANE_NAME_SCAN_BR_Y, unused, bottom)) {
+        return true;
+    }
+
+    // The device stays open, so the area of the previous scan has to be reset
+    const QRectF fullArea(QPointF(left, top), QPointF(right, bottom));
+    if (!setScanArea(fullArea)) {
+        qWarning() << "Failed to reset scan area";
+    }
+
+    // Media of a known size lies against the top-left corner of a flatbed.
+    // A feeder's guides centre it across the area the backend reports (the
+    // page width on the fi-800R), and it is read from the leading edge.
+    auto useMediaArea = [&]() {
+        if (!profile.hasSize()) {
+            return;
+        }
+        const double mediaLeft = isSheetFed()
+            ? left + (fullArea.width() - profile.sizeMm.width()) / 2 - kPreviewMarginMm
+            : left;
+        const QRectF mediaArea = QRectF(QPointF(mediaLeft, top), profile.sizeMm)
+                                     .adjusted(0, 0, 2 * kPreviewMarginMm, 2 * kPreviewMarginMm)
+                                     .intersected(fullArea);
+        if (setScanArea(mediaArea)) {
+            qInfo() << "Scanning the" << profile.name << "area" << mediaArea << "mm";
+        } else {
+            qWarning() << "Failed to set media area, scanning the full area";
+            setScanArea(fullArea);
+        }
+    };
+
+    if (!m_settings->previewScan || m_settings->previewDpi <= 0 ||
+        m_settings->previewDpi >= profile.dpi || isSheetFed()) {
+        useMediaArea();
+        return true;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    ScanFrame preview;
+    if (!setOption(SANE_NAME_SCAN_RESOLUTION, m_settings->previewDpi) ||
+        !readFrame(preview, m_settings->previewDpi, false, nullptr, errorMessage)) {
+        if (m_cancelRequested) {
+            return false;
+        }
+        qWarning() << "Preview scan failed, scanning the media area:" << errorMessage;
+        errorMessage.clear();
+        useMediaArea();
+        return setOption(SANE_NAME_SCAN_RESOLUTION, profile.dpi);
+    }
+    m_device->cancel();
+
+    if (preview.isJpeg()) {
+        preview.image = cv::imdecode(cv::Mat(1, preview.jpeg.size(), CV_8UC1, preview.jpeg.data()),
+                                     cv::IMREAD_COLOR);
+    }
+
+    AutoCrop::CropResult result = m_autoCrop.detectPhotoBounds(preview.image, m_settings->cropDetectionThreshold);
+    if (!result.success || result.cropRect == QRect(0, 0, preview.image.cols, preview.image.rows)) {
+        qInfo() << "No photo found in preview, scanning the media area";
+        useMediaArea();
+    } else {
+        const double mmPerPixel = kMmPerInch / m_settings->previewDpi;
+        const QSizeF photoSize(result.cropRect.width() * mmPerPixel, result.cropRect.height() * mmPerPixel);
+
+        // The measured photo decides which kind of media this is
+        if (detectFrom) {
+            const MediaProfile detected = detectFrom->match(photoSize);
+            if (detected.isValid() && detected.id != profile.id) {
+                qInfo() << "Preview detected" << detected.name << "(" << photoSize << "mm)";
+                profile = detected;
+                if (!setOption(SANE_NAME_SCAN_MODE, profile.mode)) {
+                    errorMessage = QString("Scanner does not support mode: %1").arg(profile.mode);
+                    return false;
+                }
+            }
+        }
+
+        // A black-and-white photo needs a third of the data in Gray mode
+        const cv::Rect photoPixels(result.cropRect.x(), result.cropRect.y(),
+                                   result.cropRect.width(), result.cropRect.height());
+        if (m_settings->grayscaleDetection && profile.mode == SANE_VALUE_SCAN_MODE_COLOR &&
+            m_autoCrop.isGrayscale(preview.image(photoPixels & cv::Rect(0, 0, preview.image.cols, preview.image.rows)))) {
+            if (setOption(SANE_NAME_SCAN_MODE, SANE_VALUE_SCAN_MODE_GRAY)) {
+                qInfo() << "Preview found a black-and-white photo, scanning in Gray";
+                profile.mode = SANE_VALUE_SCAN_MODE_GRAY;
+            } else {
+                qWarning() << "Scanner does not support Gray mode, scanning in colour";
+                setOption(SANE_NAME_SCAN_MODE, profile.mode);
+            }
+        }
+
+        QRectF photoArea(QPointF(left + result.cropRect.left() * mmPerPixel,
+                                 top + result.cropRect.top() * mmPerPixel),
+                         photoSize);
+        photoArea = photoArea.adjusted(-kPreviewMarginMm, -kPreviewMarginMm,
+                                       kPreviewMarginMm, kPreviewMarginMm).intersected(fullArea);
+
+        if (setScanArea(photoArea)) {
+            qInfo() << "Preview found photo at" << photoArea << "mm, scanning"
+                    << qRound(100.0 * photoArea.width() * photoArea.height() /
+                              (fullArea.width() * fullArea.height()))
+                    << "% of the area (preview took" << timer.elapsed() << "ms)";
+        } else {
+            qWarning() << "Failed to set scan area, scanning the full area";
+            setScanArea(fullArea);
+        }
+    }
+
+    if (!setOption(SANE_NAME_SCAN_RESOLUTION, profile.dpi)) {
+        errorMessage = QString("Scanner does not support %1 dpi").arg(profile.dpi);
+        return false;
+    }
+    return true;
+}
+
+bool ScannerWorker::readFrame(ScanFrame& frame, int dpi, bool reportProgress, ScanLineSink* sink,
+                               QString& errorMessage) {
+    SANE_Status status = m_device->start();
+    m_lastStatus = status;
+    if (status != SANE_STATUS_GOOD) {
+        m_device->cancel();
+        errorMessage = describeStatus(status);
+        return false;
+    }
+
+    SANE_Parameters params;
+    status = m_device->getParameters(&params);
+    if (status != SANE_STATUS_GOOD) {
+        m_device->cancel();
+        errorMessage = describeStatus(status);
+        return false;
+    }
+
+    // Compressed pages have no scanline layout to stream
+    if (params.format == kSaneFrameJpeg) {
+        if (sink) {
+            sink->endPage(false);
+        }
+        return readJpegFrame(params, frame, dpi, reportProgress, errorMessage);
+    }
+
+    int channels = 0;
+    if (params.format == SANE_FRAME_RGB) {
+        channels = 3;
+    } else if (params.format == SANE_FRAME_GRAY) {
+        channels = 1;
+    }
+
+    const bool lineart = (channels == 1 && params.depth == 1);
+    if (channels == 0 || (params.depth != 8 && !lineart)) {
+        m_device->cancel();
+        qCritical() << "Unsupported frame format" << params.format << "depth" << params.depth;
+        errorMessage = "Unsupported scanner image format";
+        return false;
+    }
+
+    const int width = params.pixels_per_line;
+    const int bytesPerLine = params.bytes_per_line;
+    if (width <= 0 || bytesPerLine <= 0) {
+        m_device->cancel();
+        errorMessage = "Scanner reported invalid image size";
+        return false;
+    }
+
+    // Feeders usually report an unknown length (-1); start from the crop height and grow
+    int capacityLines = params.lines > 0 ? params.lines : std::max(m_settings->cropY2, 1);
+    cv::Mat raw(capacityLines, bytesPerLine, CV_8UC1);
+    size_t filled = 0;
+    int lastProgress = -1;
+
+    // Progress is estimated against the crop height when the length is unknown
+    const size_t expectedBytes = static_cast<size_t>(capacityLines) * bytesPerLine;
+
+    // 8-bit rows are converted to BGR in place and published in bands while
+    // the page is still feeding; bands stay valid even if the buffer grows
+    const bool streamable = !lineart && bytesPerLine % channels == 0;
+    if (!streamable) {
+        sink = nullptr;
+    }
+    int publishedLines = 0;
+
+    auto publishLines = [&](int completeLines) {
+        cv::Mat band = raw.rowRange(publishedLines, completeLines).reshape(channels).colRange(0, width);
+        if (channels == 3) {
+            cv::cvtColor(band, band, cv::COLOR_RGB2BGR);
+        }
+        if (sink) {
+            sink->addRows(band);
+        }
+        publishedLines = completeLines;
+    };
+
+    auto abortScan = [&](SANE_Status reason) {
+        m_device->cancel();
+        if (sink) {
+            sink->endPage(false);
+        }
+        errorMessage = describeStatus(reason);
+        return false;
+    };
+
+    if (sink) {
+        sink->beginPage(width, channels, dpi);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while (true) {
+        if (m_cancelRequested) {
+            return abortScan(SANE_STATUS_CANCELLED);
+        }
+
+        size_t capacity = raw.total();
+        if (filled == capacity) {
+            cv::Mat grown(raw.rows + raw.rows / 2 + 1, bytesPerLine, CV_8UC1);
+            raw.copyTo(grown.rowRange(0, raw.rows));
+            raw = grown;
+            capacity = raw.total();
+        }
+
+        SANE_Int length = 0;
+        SANE_Int request = static_cast<SANE_Int>(std::min(capacity - filled, kReadChunkBytes));
+        status = m_device->read(raw.data + filled, request, &length);
+
+        if (status == SANE_STATUS_EOF) {
+            break;
+        }
+        if (status != SANE_STATUS_GOOD) {
+            return abortScan(status);
+        }
+
+        filled += length;
+
+        if (streamable) {
+            const int completeLines = static_cast<int>(filled / bytesPerLine);
+            if (completeLines - publishedLines >= kBandLines) {
+                publishLines(completeLines);
+            }
+        }
+
+        int progress = static_cast<int>(std::min<size_t>(99, filled * 100 / expectedBytes));
+        if (reportProgress && progress != lastProgress) {
+            lastProgress = progress;
+            emit scanProgress(m_page, (m_side * 100 + progress) / m_sides);
+        }
+    }
+
+    // The caller ends the scan cycle with sane_cancel(); a batch calls
+    // sane_start() again for the next page instead
+    const int lines = static_cast<int>(filled / bytesPerLine);
+    if (lines == 0) {
+        if (sink) {
+            sink->endPage(false);
+        }
+        errorMessage = "Scanner produced empty image";
+        return false;
+    }
+
+    cv::Mat rows = raw.rowRange(0, lines);
+
+    if (lineart) {
+        // 1 bit per pixel, set bits are black
+        cv::Mat gray(lines, width, CV_8UC1);
+        for (int y = 0; y < lines; y++) {
+            const uchar* src = rows.ptr<uchar>(y);
+            uchar* dst = gray.ptr<uchar>(y);
+            for (int x = 0; x < width; x++) {
+                dst[x] = (src[x >> 3] & (0x80 >> (x & 7))) ? 0 : 255;
+            }
+        }
+        frame.image = gray;
+    } else if (streamable) {
+        if (lines > publishedLines) {
+            publishLines(lines);
+        }
+        // Wrap the received bytes without copying
+        frame.image = rows.reshape(channels).colRange(0, width);
+    } else {
+        frame.image.create(lines, width, CV_MAKETYPE(CV_8U, channels));
+        for (int y = 0; y < lines; y++) {
+            std::memcpy(frame.image.ptr<uchar>(y), rows.ptr<uchar>(y), static_cast<size_t>(width) * channels);
+        }
+        // SANE delivers RGB, OpenCV works in BGR
+        if (channels == 3) {
+            cv::cvtColor(frame.image, frame.image, cv::COLOR_RGB2BGR);
+        }
+    }
+
+    if (sink) {
+        sink->endPage(true);
+    }
+
+    frame.dpi = dpi;
+    const qint64 elapsed = std::max<qint64>(1, timer.elapsed());
+    qInfo() << "Captured" << width << "x" << lines << "pixels at" << dpi << "dpi in" << elapsed << "ms ("
+            << qRound(filled / 1024.0 / 1024.0 * 1000.0 / elapsed) << "MB/s)";
+    return true;
+}
+
+bool ScannerWorker::readJpegFrame(const SANE_Parameters& params, ScanFrame& frame, int dpi,
+                                   bool reportProgress, QString& errorMessage) {
+    // Progress is estimated against roughly 1:10 compression of the raw size;
+    // sheet-fed pages of unknown length are assumed to be about square
+    const int lines = params.lines > 0 ? params.lines : std::max(params.pixels_per_line, 1);
+    const qint64 expectedBytes = std::max<qint64>(1, static_cast<qint64>(lines) * params.bytes_per_line / 10);
+
+    QByteArray data(static_cast<int>(kReadChunkBytes), Qt::Uninitialized);
+    qint64 filled = 0;
+    int lastProgress = -1;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while (true) {
+        if (m_cancelRequested) {
+            m_device->cancel();
+            errorMessage = describeStatus(SANE_STATUS_CANCELLED);
+            return false;
+        }
+
+        if (filled == data.size()) {
+            data.resize(data.size() + data.size() / 2);
+        }
+
+        SANE_Int length = 0;
+        SANE_Int request = static_cast<SANE_Int>(std::min<qint64>(data.size() - filled, kReadChunkBytes));
+        SANE_Status status = m_device->read(reinterpret_cast<SANE_Byte*>(data.data()) + filled, request, &length);
+
+        if (status == SANE_STATUS_EOF) {
+            break;
+        }
+        if (status != SANE_STATUS_GOOD) {
+            m_device->cancel();
+            errorMessage = describeStatus(status);
+            return false;
+        }
+
+        filled += length;
+
+        int progress = static_cast<int>(std::min<qint64>(99, filled * 100 / expectedBytes));
+        if (reportProgress && progress != lastProgress) {
+            lastProgress = progress;
+            emit scanProgress(m_page, (m_side * 100 + progress) / m_sides);
+        }
+    }
+
+    if (filled == 0) {
+        errorMessage = "Scanner produced empty image";
+        return false;
+    }
+
+    data.truncate(static_cast<int>(filled));
+    frame.jpeg = data;
+    frame.dpi = dpi;
+    qInfo() << "Captured" << filled / 1024 << "KB JPEG at" << dpi << "dpi in" << timer.elapsed() << "ms";
+    return true;
+}
+
+void ScannerWorker::scanTask(std::shared_ptr<ScanBatch> batch) {
+    // A preview may switch this scanner to a detected profile
+    MediaProfile profile = batch->profile();
+    QString errorMessage;
+    bool success = true;
+    int pagesScanned = 0;
+
+    if (m_settings->demoMode) {
+        // Demo mode: generate fake scans in memory
+        qInfo() << "DEMO MODE: Mock scanning" << batch->pageCount() << "page(s)";
+    } else {
+        qInfo() << "Starting scan on" << m_deviceName << "-" << batch->pageCount() << "page(s) in the batch,"
+                << profile.name;
+        const bool opened = openDevice(errorMessage);
+        success = opened &&
+                  applyScanOptions(profile, errorMessage) &&
+                  waitForDocument(*batch, errorMessage) &&
+                  selectScanArea(profile, batch->detectFrom(), errorMessage);
+
+        if (!opened) {
+            // The device may have come back under a different USB address
+            emit deviceUnavailable();
+        }
+    }
+
+    // Pages are fed back to back in one session; each one is handed on as
+    // soon as it has been read. Other scanners claim pages from the same batch.
+    // Duplex backends deliver the back of a page in the next scan cycle.
+    m_sides = m_settings->duplexScan ? 2 : 1;
+    bool feederEmpty = false;
+
+    while (success && !feederEmpty) {
+        const int page = batch->claimPage();
+        if (page < 0) {
+            break;
+        }
+        m_page = page;
+
+        for (int side = 0; side < m_sides; side++) {
+            m_side = side;
+            // Only the front is streamed; the back goes through the regular path
+            ScanLineSink* sink = side == 0 ? batch->sink(page) : nullptr;
+
+            // Under memory pressure the page goes to disk; streaming bands would
+            // keep the whole buffer alive, so the sink is skipped as well
+            const bool spill = isMemoryLow();
+            if (spill) {
+                sink = nullptr;
+            }
+
+            ScanFrame frame;
+            if (m_settings->demoMode) {
+                frame = createDemoScan(side);
+                if (sink) {
+                    sink->beginPage(frame.image.cols, frame.image.channels(), frame.dpi);
+                    for (int y = 0; y < frame.image.rows; y += kBandLines) {
+                        sink->addRows(frame.image.rowRange(y, std::min(frame.image.rows, y + kBandLines)));
+                    }
+                    sink->endPage(true);
+                }
+            } else if (!readFrame(frame, profile.dpi, true, sink, errorMessage)) {
+                // The front was delivered already if the back fails
+                if (side > 0) {
+                    success = false;
+                    break;
+                }
+
+                // Another scanner may still get this page
+                batch->returnPage(page);
+                emit scanProgress(page, 0);
+
+                // An empty feeder ends this scanner's part early. Before the
+                // first page it just had no paper (a scanner without a paper
+                // sensor only finds out here), which is no error while another
+                // scanner has the strips; the manager reports a batch that
+                // got no page at all.
+                if (m_lastStatus == SANE_STATUS_NO_DOCS && !m_cancelRequested) {
+                    qInfo() << m_deviceName << "feeder empty after" << pagesScanned << "page(s)";
+                    errorMessage.clear();
+                    feederEmpty = true;
+                } else {
+                    success = false;
+                }
+                break;
+            }
+
+            frame.page = page;
+            frame.side = side;
+            frame.profile = profile.id;
+            if (spill && !frame.isJpeg()) {
+                spillFrame(frame);
+            }
+            if (side == 0) {
+                pagesScanned++;
+            }
+            if (side == m_sides - 1) {
+                qInfo() << "Page" << (page + 1) << "of" << batch->pageCount() << "scanned on" << m_deviceName;
+                emit scanProgress(page, 100);
+            }
+            emit scanCompleted(frame);
+        }
+    }
+
+    if (!m_settings->demoMode && m_device) {
+        // Completes the scan cycle so the next sane_start() begins a new batch
+        m_device->cancel();
+        if (!success && !m_cancelRequested) {
+            // Reopen on the next scan in case the device was reset or unplugged
+            closeDevice();
+        }
+    }
+
+    m_scanning = false;
+    m_page = 0;
+    m_side = 0;
+
+    if (success) {
+        qInfo() << m_deviceName << "finished:" << pagesScanned << "page(s)";
+        emit finished(pagesScanned, QString());
+    } else {
+        qCritical() << "Scan failed on" << m_deviceName << ":" << errorMessage;
+        emit finished(pagesScanned, errorMessage);
+    }
+}
+
+void ScannerWorker::warmUp(const MediaProfile& profile) {
+    if (m_settings->demoMode || m_scanning || m_warmingUp) {
+        return;
+    }
+
+    // Queued on the scanner thread, so a scan requested meanwhile simply
+    // starts on the already opened and configured device
+    m_warmingUp = true;
+    m_scanPool.start([this, profile]() {
+        QElapsedTimer timer;
+        timer.start();
+
+        // Opening the device and writing the options is what talks to the
+        // scanner and wakes it
+        QString errorMessage;
+        if (openDevice(errorMessage) && applyScanOptions(profile, errorMessage)) {
+            qInfo() << m_deviceName << "warmed up in" << timer.elapsed() << "ms";
+        } else {
+            qWarning() << m_deviceName << "warm-up failed:" << errorMessage;
+            closeDevice();
+        }
+        m_warmingUp = false;
+    });
+}
+
+void ScannerWorker::cancelScan() {
+    if (!m_scanning) {
+        return;
+    }
+
+    qInfo() << "Cancelling scan on" << m_deviceName;
+    m_cancelRequested = true;
+
+    // Aborts a blocking read on whichever device is scanning
+    m_saneDevice.cancel();
+    m_simulatedDevice.cancel();
+}
+
+void ScannerWorker::onScanTimeout() {
+    qCritical() << "Scan timeout on" << m_deviceName;
+    m_timedOut = true;
+    cancelScan();
+}
+
+QString ScannerWorker::describeStatus(SANE_Status status) const {
+    if (m_timedOut) {
+        return "Scan timeout - please try again";
+    }
+    if (status == SANE_STATUS_CANCELLED || m_cancelRequested) {
+        return "Scan cancelled";
+    }
+    return QString("Scanner error: %1").arg(sane_strstatus(status));
+}
+
+bool ScannerWorker::isMemoryLow() const {
+    if (m_settings->spillThresholdMb <= 0) {
+        return false;
+    }
+
+    const qint64 available = availableMemoryBytes();
+    if (available < 0) {
+        return false;
+    }
+
+    // Leave room for one more page of the expected size
+    const qint64 pageBytes = static_cast<qint64>(m_settings->cropX2) * m_settings->cropY2 * 3;
+    const qint64 threshold = static_cast<qint64>(m_settings->spillThresholdMb) * 1024 * 1024;
+    if (available - pageBytes >= threshold) {
+        return false;
+    }
+
+    qWarning() << "Low memory:" << available / (1024 * 1024) << "MB available, spilling page to disk";
+    return true;
+}
+
+bool ScannerWorker::spillFrame(ScanFrame& frame) {
+    QElapsedTimer timer;
+    timer.start();
+
+    const QString path = m_settings->scansDir.filePath(
+        QString("spill_%1.tiff").arg(QUuid::createUuid().toString(QUuid::WithoutBraces)));
+
+    // Uncompressed: the file is read back once and removed
+    std::vector<int> params = {cv::IMWRITE_TIFF_COMPRESSION, 1};
+    bool written = false;
+    try {
+        written = cv::imwrite(path.toStdString(), frame.image, params);
+    } catch (const cv::Exception& e) {
+        qWarning() << "OpenCV exception spilling page:" << e.what();
+    }
+
+    if (!written) {
+        qWarning() << "Failed to spill page to disk, keeping it in memory";
+        QFile::remove(path);
+        return false;
+    }
+
+    qInfo() << "Spilled page to" << path << "in" << timer.elapsed() << "ms";
+    frame.spillPath = path;
+    frame.image.release();
+    return true;
+}
+
+ScanFrame ScannerWorker::createDemoScan(int side) {
+    // Create a fake scan (white image with colored rectangles to simulate photo strip)
+    ScanFrame frame;
+    frame.dpi = m_settings->scannerDpi;
+    frame.image = cv::Mat(1988, 1725, CV_8UC3, cv::Scalar(255, 255, 255));
+
+    if (side > 0) {
+        // Back of the strip: a handwritten note
+        cv::rectangle(frame.image, cv::Rect(300, 200, 1125, 1400), cv::Scalar(235, 240, 245), cv::FILLED);
+        cv::putText(frame.image, "Summer 2026", cv::Point(420, 800), cv::FONT_HERSHEY_SCRIPT_SIMPLEX,
+                    4.0, cv::Scalar(90, 40, 20), 6);
+        qInfo() << "DEMO MODE: Mock scan of the back completed";
+        return frame;
+    }
+
+    // Add colored boxes to simulate photo strip (BGR)
+    cv::rectangle(frame.image, cv::Rect(300, 200, 1125, 400), cv::Scalar(200, 200, 255), cv::FILLED); // Pink
+    cv::rectangle(frame.image, cv::Rect(300, 700, 1125, 400), cv::Scalar(200, 255, 200), cv::FILLED); // Green
+    cv::rectangle(frame.image, cv::Rect(300, 1200, 1125, 400), cv::Scalar(255, 200, 200), cv::FILLED); // Blue
+
+    qInfo() << "DEMO MODE: Mock scan completed";
+    return frame;
+}
@@ -0,0 +1,475 @@
+#include "SimulatedScanDevice.h"
+#include <QRandomGenerator>
+#include <QThread>
+#include <QDebug>
+#include <sane/saneopts.h>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+// Scan area of the card feeder; 1725 x 1988 pixels at 600 dpi
+constexpr double kPageWidthMm = 73.0;
+constexpr double kPageHeightMm = 84.2;
+constexpr double kMmPerInch = 25.4;
+
+// Photo strip layout on the page (x, y, width, height in mm)
+constexpr double kFrameX = 12.7;
+constexpr double kFrameWidth = 47.6;
+constexpr double kFrameHeight = 16.9;
+constexpr double kFrameY[] = {8.5, 29.6, 50.8};
+
+const SANE_String_Const kSources[] = {"Flatbed", "Card Front", "Card Back", "Card Duplex", nullptr};
+const SANE_String_Const kModes[] = {"Color", "Gray", "Lineart", nullptr};
+const SANE_Range kResolutionRange = {50, 1200, 1};
+const SANE_Range kXRange = {0, SANE_FIX(kPageWidthMm), 0};
+const SANE_Range kYRange = {0, SANE_FIX(kPageHeightMm), 0};
+
+constexpr size_t kNoEvent = SIZE_MAX;
+constexpr SANE_Int kStringOptionSize = 32;
+
+SANE_Option_Descriptor makeOption(SANE_String_Const name, SANE_String_Const title, SANE_Value_Type type,
+                                  SANE_Unit unit, SANE_Int size) {
+    SANE_Option_Descriptor desc;
+    std::memset(&desc, 0, sizeof(desc));
+    desc.name = name;
+    desc.title = title;
+    desc.desc = title;
+    desc.type = type;
+    desc.unit = unit;
+    desc.size = size;
+    desc.cap = SANE_CAP_SOFT_SELECT | SANE_CAP_SOFT_DETECT;
+    desc.constraint_type = SANE_CONSTRAINT_NONE;
+    return desc;
+}
+
+bool inList(const SANE_String_Const* list, const char* value) {
+    for (int i = 0; list[i]; i++) {
+        if (std::strcmp(list[i], value) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+const char* const SimulatedScanDevice::DeviceName = "simulated:fi-800R";
+
+QString SimulatedScanDevice::deviceName(int index) {
+    const QString name = QString::fromLatin1(DeviceName);
+    return index == 0 ? name : QString("%1-%2").arg(name).arg(index + 1);
+}
+
+bool SimulatedScanDevice::isSimulated(const QString& deviceName) {
+    return deviceName.startsWith(QLatin1String(DeviceName));
+}
+
+SimulatedScanDevice::SimulatedScanDevice(AppSettings* settings)
+    : m_settings(settings)
+    , m_open(false)
+    , m_cancelled(false)
+    , m_resolution(300)
+    , m_batchActive(false)
+    , m_pagesLeft(0)
+    , m_backPending(false)
+    , m_pageDpi(0)
+    , m_bytesRead(0)
+    , m_jamOffset(kNoEvent)
+    , m_stallOffset(kNoEvent)
+{
+    std::memset(&m_params, 0, sizeof(m_params));
+    setupOptions();
+}
+
+SimulatedScanDevice::~SimulatedScanDevice() {
+}
+
+void SimulatedScanDevice::setupOptions() {
+    m_options.resize(OptionTotal);
+
+    m_options[OptionCount] = makeOption(SANE_NAME_NUM_OPTIONS, SANE_TITLE_NUM_OPTIONS,
+                                        SANE_TYPE_INT, SANE_UNIT_NONE, sizeof(SANE_Word));
+    m_options[OptionCount].cap = SANE_CAP_SOFT_DETECT;
+
+    m_options[OptionSource] = makeOption(SANE_NAME_SCAN_SOURCE, SANE_TITLE_SCAN_SOURCE,
+                                         SANE_TYPE_STRING, SANE_UNIT_NONE, kStringOptionSize);
+    m_options[OptionSource].constraint_type = SANE_CONSTRAINT_STRING_LIST;
+    m_options[OptionSource].constraint.string_list = kSources;
+
+    m_options[OptionMode] = makeOption(SANE_NAME_SCAN_MODE, SANE_TITLE_SCAN_MODE,
+                                       SANE_TYPE_STRING, SANE_UNIT_NONE, kStringOptionSize);
+    m_options[OptionMode].constraint_type = SANE_CONSTRAINT_STRING_LIST;
+    m_options[OptionMode].constraint.string_list = kModes;
+
+    m_options[OptionResolution] = makeOption(SANE_NAME_SCAN_RESOLUTION, SANE_TITLE_SCAN_RESOLUTION,
+                                             SANE_TYPE_INT, SANE_UNIT_DPI, sizeof(SANE_Word));
+    m_options[OptionResolution].constraint_type = SANE_CONSTRAINT_RANGE;
+    m_options[OptionResolution].constraint.range = &kResolutionRange;
+
+    const SANE_String_Const geometryNames[] = {SANE_NAME_SCAN_TL_X, SANE_NAME_SCAN_TL_Y,
+                                               SANE_NAME_SCAN_BR_X, SANE_NAME_SCAN_BR_Y};
+    const SANE_String_Const geometryTitles[] = {SANE_TITLE_SCAN_TL_X, SANE_TITLE_SCAN_TL_Y,
+                                                SANE_TITLE_SCAN_BR_X, SANE_TITLE_SCAN_BR_Y};
+    for (int i = 0; i < 4; i++) {
+        SANE_Option_Descriptor& desc = m_options[OptionTopLeftX + i];
+        desc = makeOption(geometryNames[i], geometryTitles[i], SANE_TYPE_FIXED, SANE_UNIT_MM, sizeof(SANE_Word));
+        desc.constraint_type = SANE_CONSTRAINT_RANGE;
+        desc.constraint.range = (i % 2 == 0) ? &kXRange : &kYRange;
+    }
+
+    // Read-only paper sensor, like the fujitsu backend's
+    m_options[OptionPageLoaded] = makeOption("page-loaded", "Page loaded", SANE_TYPE_BOOL,
+                                             SANE_UNIT_NONE, sizeof(SANE_Word));
+    m_options[OptionPageLoaded].cap = SANE_CAP_HARD_SELECT | SANE_CAP_SOFT_DETECT;
+}
+
+SANE_Status SimulatedScanDevice::open(const QString& deviceName) {
+    if (!isSimulated(deviceName)) {
+        return SANE_STATUS_INVAL;
+    }
+
+    m_open = true;
+    m_cancelled = false;
+    m_batchActive = false;
+
+    m_source = "Card Front";
+    m_mode = "Color";
+    m_resolution = 300;
+    m_geometry[0] = 0;
+    m_geometry[1] = 0;
+    m_geometry[2] = kXRange.max;
+    m_geometry[3] = kYRange.max;
+
+    qInfo() << "Simulated scanner:" << m_settings->simLinesPerSecond << "lines/s,"
+            << m_settings->simStartLatencyMs << "ms feed latency," << m_settings->simJitterPercent
+            << "% jitter," << m_settings->simJamPercent << "% jams," << m_settings->simTimeoutPercent
+            << "% stalls";
+    return SANE_STATUS_GOOD;
+}
+
+void SimulatedScanDevice::close() {
+    m_cancelled = true;
+    m_open = false;
+    m_scan.release();
+}
+
+bool SimulatedScanDevice::isOpen() const {
+    return m_open;
+}
+
+const SANE_Option_Descriptor* SimulatedScanDevice::optionDescriptor(SANE_Int option) {
+    if (!m_open || option < 0 || option >= OptionTotal) {
+        return nullptr;
+    }
+    return &m_options[option];
+}
+
+SANE_Status SimulatedScanDevice::controlOption(SANE_Int option, SANE_Action action, void* value, SANE_Int* info) {
+    if (!m_open || option < 0 || option >= OptionTotal || !value) {
+        return SANE_STATUS_INVAL;
+    }
+    if (info) {
+        *info = 0;
+    }
+
+    if (action == SANE_ACTION_GET_VALUE) {
+        switch (option) {
+        case OptionCount:
+            *static_cast<SANE_Int*>(value) = OptionTotal;
+            break;
+        case OptionSource:
+        case OptionMode: {
+            const QByteArray text = (option == OptionSource ? m_source : m_mode).toLatin1();
+            std::strncpy(static_cast<char*>(value), text.constData(), kStringOptionSize - 1);
+            static_cast<char*>(value)[kStringOptionSize - 1] = '\0';
+            break;
+        }
+        case OptionResolution:
+            *static_cast<SANE_Int*>(value) = m_resolution;
+            break;
+        case OptionPageLoaded: {
+            // A new batch starts with a full feeder
+            const bool batchEnded = m_cancelled || !m_batchActive;
+            *static_cast<SANE_Bool*>(value) = (batchEnded || m_pagesLeft > 0) ? SANE_TRUE : SANE_FALSE;
+            break;
+        }
+        default:
+            *static_cast<SANE_Fixed*>(value) = m_geometry[option - OptionTopLeftX];
+            break;
+        }
+        return SANE_STATUS_GOOD;
+    }
+
+    if (action != SANE_ACTION_SET_VALUE || option == OptionCount || option == OptionPageLoaded) {
+        return SANE_STATUS_UNSUPPORTED;
+    }
+
+    switch (option) {
+    case OptionSource:
+    case OptionMode: {
+        const char* text = static_cast<const char*>(value);
+        if (!inList(option == OptionSource ? kSources : kModes, text)) {
+            return SANE_STATUS_INVAL;
+        }
+        (option == OptionSource ? m_source : m_mode) = QString::fromLatin1(text);
+        break;
+    }
+    case OptionResolution: {
+        const SANE_Int requested = *static_cast<SANE_Int*>(value);
+        m_resolution = std::clamp(requested, kResolutionRange.min, kResolutionRange.max);
+        if (info && m_resolution != requested) {
+            *info |= SANE_INFO_INEXACT;
+        }
+        break;
+    }
+    default: {
+        const SANE_Range* range = m_options[option].constraint.range;
+        const SANE_Fixed requested = *static_cast<SANE_Fixed*>(value);
+        m_geometry[option - OptionTopLeftX] = std::clamp(requested, range->min, range->max);
+        if (info && m_geometry[option - OptionTopLeftX] != requested) {
+            *info |= SANE_INFO_INEXACT;
+        }
+        break;
+    }
+    }
+
+    if (info) {
+        *info |= SANE_INFO_RELOAD_PARAMS;
+    }
+    return SANE_STATUS_GOOD;
+}
+
+bool SimulatedScanDevice::isSheetFed() const {
+    return m_source != "Flatbed";
+}
+
+bool SimulatedScanDevice::isDuplex() const {
+    return m_source == "Card Duplex";
+}
+
+void SimulatedScanDevice::renderPage() {
+    if (m_pageDpi == m_resolution && !m_page.empty()) {
+        return;
+    }
+
+    const double pixelsPerMm = m_resolution / kMmPerInch;
+    m_page = cv::Mat(qRound(kPageHeightMm * pixelsPerMm), qRound(kPageWidthMm * pixelsPerMm),
+                     CV_8UC3, cv::Scalar(250, 250, 248));
+    m_pageDpi = m_resolution;
+
+    // Smooth colour fields with fine grain, so encoders see photo-like data.
+    // A fixed seed keeps the pages identical between runs.
+    cv::RNG rng(0x5ca9);
+    for (double frameY : kFrameY) {
+        cv::Rect rect(qRound(kFrameX * pixelsPerMm), qRound(frameY * pixelsPerMm),
+                      qRound(kFrameWidth * pixelsPerMm), qRound(kFrameHeight * pixelsPerMm));
+        rect &= cv::Rect(0, 0, m_page.cols, m_page.rows);
+        if (rect.empty()) {
+            continue;
+        }
+
+        cv::Mat coarse(6, 16, CV_8UC3);
+        rng.fill(coarse, cv::RNG::UNIFORM, 20, 230);
+        cv::Mat frame = m_page(rect);
+        cv::resize(coarse, frame, rect.size(), 0, 0, cv::INTER_CUBIC);
+
+        cv::Mat grain(rect.size(), CV_8UC3);
+        rng.fill(grain, cv::RNG::UNIFORM, 0, 24);
+        cv::subtract(frame, grain, frame);
+    }
+
+    // Back of the card: a short handwritten note
+    m_backPage = cv::Mat(m_page.size(), CV_8UC3, cv::Scalar(248, 246, 240));
+    const double scale = pixelsPerMm / 12.0;
+    cv::putText(m_backPage, "Best night ever!", cv::Point(qRound(kFrameX * pixelsPerMm), qRound(30.0 * pixelsPerMm)),
+                cv::FONT_HERSHEY_SCRIPT_SIMPLEX, scale, cv::Scalar(30, 40, 110),
+                std::max(1, qRound(scale * 2)), cv::LINE_AA);
+    cv::putText(m_backPage, "June 2026", cv::Point(qRound(kFrameX * pixelsPerMm), qRound(45.0 * pixelsPerMm)),
+                cv::FONT_HERSHEY_SCRIPT_SIMPLEX, scale, cv::Scalar(30, 40, 110),
+                std::max(1, qRound(scale * 2)), cv::LINE_AA);
+}
+
+SANE_Status SimulatedScanDevice::start() {
+    if (!m_open) {
+        return SANE_STATUS_INVAL;
+    }
+
+    // A cancelled cycle ends the batch; the next one starts with a full feeder
+    if (m_cancelled || !m_batchActive) {
+        m_batchActive = true;
+        m_pagesLeft = std::max(1, m_settings->simFeederPages);
+        m_backPending = false;
+    }
+    m_cancelled = false;
+
+    // In duplex mode every other cycle returns the back of the page just fed
+    const bool back = m_backPending;
+    m_backPending = isDuplex() && !back;
+
+    if (isSheetFed() && !back) {
+        if (m_pagesLeft <= 0) {
+            m_backPending = false;
+            return SANE_STATUS_NO_DOCS;
+        }
+        m_pagesLeft--;
+    }
+
+    // Paper pickup and feed; the back was read during the same pass
+    if (!back && !waitFor(jittered(m_settings->simStartLatencyMs))) {
+        return SANE_STATUS_CANCELLED;
+    }
+
+    try {
+        renderPage();
+
+        const double pixelsPerMm = m_resolution / kMmPerInch;
+        const int x0 = std::clamp(static_cast<int>(std::lround(SANE_UNFIX(m_geometry[0]) * pixelsPerMm)), 0, m_page.cols - 1);
+        const int y0 = std::clamp(static_cast<int>(std::lround(SANE_UNFIX(m_geometry[1]) * pixelsPerMm)), 0, m_page.rows - 1);
+        const int x1 = std::clamp(static_cast<int>(std::lround(SANE_UNFIX(m_geometry[2]) * pixelsPerMm)), x0 + 1, m_page.cols);
+        const int y1 = std::clamp(static_cast<int>(std::lround(SANE_UNFIX(m_geometry[3]) * pixelsPerMm)), y0 + 1, m_page.rows);
+        cv::Mat area = (back ? m_backPage : m_page)(cv::Rect(x0, y0, x1 - x0, y1 - y0));
+
+        m_params.last_frame = SANE_TRUE;
+        m_params.pixels_per_line = area.cols;
+        m_params.depth = 8;
+
+        if (m_mode == "Color") {
+            m_params.format = SANE_FRAME_RGB;
+            m_scan = area;
+        } else {
+            m_params.format = SANE_FRAME_GRAY;
+            cv::Mat gray;
+            cv::cvtColor(area, gray, cv::COLOR_RGB2GRAY);
+
+            if (m_mode == "Lineart") {
+                // 1 bit per pixel, set bits are black
+                m_params.depth = 1;
+                m_scan = cv::Mat::zeros(gray.rows, (gray.cols + 7) / 8, CV_8UC1);
+                for (int y = 0; y < gray.rows; y++) {
+                    const uchar* src = gray.ptr<uchar>(y);
+                    uchar* dst = m_scan.ptr<uchar>(y);
+                    for (int x = 0; x < gray.cols; x++) {
+                        if (src[x] < 128) {
+                            dst[x >> 3] |= static_cast<uchar>(0x80 >> (x & 7));
+                        }
+                    }
+                }
+            } else {
+                m_scan = gray;
+            }
+        }
+    } catch (const cv::Exception& e) {
+        qWarning() << "Simulated scanner: OpenCV exception:" << e.what();
+        return SANE_STATUS_NO_MEM;
+    }
+
+    m_params.bytes_per_line = static_cast<SANE_Int>(m_scan.cols * m_scan.elemSize());
+    // Feeders do not know the page length in advance
+    m_params.lines = isSheetFed() ? -1 : m_scan.rows;
+    m_bytesRead = 0;
+
+    const size_t total = static_cast<size_t>(m_scan.rows) * m_params.bytes_per_line;
+    QRandomGenerator* random = QRandomGenerator::global();
+    m_jamOffset = kNoEvent;
+    m_stallOffset = kNoEvent;
+    if (random->bounded(100) < m_settings->simJamPercent) {
+        m_jamOffset = total / 4 + random->bounded(static_cast<quint64>(total / 2 + 1));
+    } else if (random->bounded(100) < m_settings->simTimeoutPercent) {
+        m_stallOffset = total / 4 + random->bounded(static_cast<quint64>(total / 2 + 1));
+    }
+
+    return SANE_STATUS_GOOD;
+}
+
+SANE_Status SimulatedScanDevice::getParameters(SANE_Parameters* params) {
+    if (!m_open || !params) {
+        return SANE_STATUS_INVAL;
+    }
+    *params = m_params;
+    return SANE_STATUS_GOOD;
+}
+
+SANE_Status SimulatedScanDevice::read(SANE_Byte* data, SANE_Int maxLength, SANE_Int* length) {
+    *length = 0;
+    if (m_cancelled) {
+        return SANE_STATUS_CANCELLED;
+    }
+    if (m_scan.empty()) {
+        return SANE_STATUS_INVAL;
+    }
+
+    const size_t bytesPerLine = static_cast<size_t>(m_params.bytes_per_line);
+    const size_t total = static_cast<size_t>(m_scan.rows) * bytesPerLine;
+    if (m_bytesRead >= total) {
+        return SANE_STATUS_EOF;
+    }
+
+    if (m_bytesRead >= m_jamOffset) {
+        qWarning() << "Simulated scanner: Paper jam";
+        return SANE_STATUS_JAMMED;
+    }
+
+    if (m_bytesRead >= m_stallOffset) {
+        // The transfer hangs until the watchdog cancels it
+        qWarning() << "Simulated scanner: Transfer stalled";
+        while (waitFor(50)) {
+        }
+        return SANE_STATUS_CANCELLED;
+    }
+
+    size_t count = std::min(static_cast<size_t>(maxLength), total - m_bytesRead);
+    count = std::min(count, std::min(m_jamOffset, m_stallOffset) - m_bytesRead);
+
+    // Transfer time at the configured line rate
+    if (m_settings->simLinesPerSecond > 0) {
+        const double lines = static_cast<double>(count) / bytesPerLine;
+        if (!waitFor(jittered(qRound(lines * 1000.0 / m_settings->simLinesPerSecond)))) {
+            return SANE_STATUS_CANCELLED;
+        }
+    }
+
+    size_t copied = 0;
+    while (copied < count) {
+        const size_t offset = m_bytesRead + copied;
+        const int row = static_cast<int>(offset / bytesPerLine);
+        const size_t column = offset % bytesPerLine;
+        const size_t chunk = std::min(count - copied, bytesPerLine - column);
+        std::memcpy(data + copied, m_scan.ptr<uchar>(row) + column, chunk);
+        copied += chunk;
+    }
+
+    m_bytesRead += count;
+    *length = static_cast<SANE_Int>(count);
+    return SANE_STATUS_GOOD;
+}
+
+void SimulatedScanDevice::cancel() {
+    m_cancelled = true;
+}
+
+bool SimulatedScanDevice::waitFor(int milliseconds) {
+    QElapsedTimer timer;
+    timer.start();
+
+    while (timer.elapsed() < milliseconds) {
+        if (m_cancelled) {
+            return false;
+        }
+        QThread::msleep(static_cast<unsigned long>(std::min<qint64>(5, milliseconds - timer.elapsed())));
+    }
+    return !m_cancelled;
+}
+
+int SimulatedScanDevice::jittered(int milliseconds) const {
+    const int jitter = std::clamp(m_settings->simJitterPercent, 0, 100);
+    if (milliseconds <= 0 || jitter == 0) {
+        return std::max(0, milliseconds);
+    }
+
+    const int percent = 100 - jitter + static_cast<int>(QRandomGenerator::global()->bounded(2 * jitter + 1));
+    return milliseconds * percent / 100;
+}
@@ -0,0 +1,20 @@
+#include "SystemMemory.h"
+#include <QFile>
+#include <QByteArray>
+#include <QList>
+
+qint64 availableMemoryBytes() {
+    QFile meminfo("/proc/meminfo");
+    if (!meminfo.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return -1;
+    }
+
+    while (!meminfo.atEnd()) {
+        const QByteArray line = meminfo.readLine();
+        if (line.startsWith("MemAvailable:")) {
+            const QList<QByteArray> fields = line.simplified().split(' ');
+            return fields.size() >= 2 ? fields[1].toLongLong() * 1024 : -1;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,231 @@
+#include "TiffRegionReader.h"
+#include <QFile>
+#include <QDebug>
+#include <QtConcurrent>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <numeric>
+#include <vector>
+#include <opencv2/imgproc.hpp>
+
+TiffRegionReader::TiffRegionReader(QThreadPool* pool)
+    : m_pool(pool)
+    , m_tiff(nullptr)
+    , m_width(0)
+    , m_height(0)
+    , m_channels(0)
+    , m_tiled(false)
+    , m_blockWidth(0)
+    , m_blockHeight(0)
+    , m_blockBytes(0)
+{
+}
+
+TiffRegionReader::~TiffRegionReader() {
+    close();
+}
+
+bool TiffRegionReader::open(const QString& path) {
+    close();
+
+    m_tiff = TIFFOpen(QFile::encodeName(path).constData(), "r");
+    if (!m_tiff) {
+        qWarning() << "TiffRegionReader: Cannot open" << path;
+        return false;
+    }
+
+    uint32_t width = 0, height = 0;
+    uint16_t bitsPerSample = 0, samplesPerPixel = 0, planar = 0, photometric = 0;
+    TIFFGetField(m_tiff, TIFFTAG_IMAGEWIDTH, &width);
+    TIFFGetField(m_tiff, TIFFTAG_IMAGELENGTH, &height);
+    TIFFGetFieldDefaulted(m_tiff, TIFFTAG_BITSPERSAMPLE, &bitsPerSample);
+    TIFFGetFieldDefaulted(m_tiff, TIFFTAG_SAMPLESPERPIXEL, &samplesPerPixel);
+    TIFFGetFieldDefaulted(m_tiff, TIFFTAG_PLANARCONFIG, &planar);
+    TIFFGetField(m_tiff, TIFFTAG_PHOTOMETRIC, &photometric);
+
+    const bool gray = samplesPerPixel == 1 && photometric == PHOTOMETRIC_MINISBLACK;
+    const bool rgb = samplesPerPixel == 3 && photometric == PHOTOMETRIC_RGB;
+    if (width == 0 || height == 0 || bitsPerSample != 8 || planar != PLANARCONFIG_CONTIG || !(gray || rgb)) {
+        qInfo() << "TiffRegionReader: Unsupported layout in" << path << "- bits" << bitsPerSample
+                << "samples" << samplesPerPixel << "photometric" << photometric;
+        close();
+        return false;
+    }
+
+    m_path = path;
+    m_width = static_cast<int>(width);
+    m_height = static_cast<int>(height);
+    m_channels = samplesPerPixel;
+    m_tiled = TIFFIsTiled(m_tiff);
+
+    if (m_tiled) {
+        uint32_t tileWidth = 0, tileHeight = 0;
+        TIFFGetField(m_tiff, TIFFTAG_TILEWIDTH, &tileWidth);
+        TIFFGetField(m_tiff, TIFFTAG_TILELENGTH, &tileHeight);
+        m_blockWidth = static_cast<int>(tileWidth);
+        m_blockHeight = static_cast<int>(tileHeight);
+        m_blockBytes = TIFFTileSize(m_tiff);
+    } else {
+        uint32_t rowsPerStrip = 0;
+        TIFFGetFieldDefaulted(m_tiff, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip);
+        m_blockWidth = m_width;
+        m_blockHeight = static_cast<int>(std::min<uint32_t>(rowsPerStrip, height));
+        m_blockBytes = TIFFStripSize(m_tiff);
+    }
+
+    if (m_blockWidth <= 0 || m_blockHeight <= 0 ||
+        m_blockBytes < static_cast<tmsize_t>(m_blockWidth) * m_blockHeight * m_channels) {
+        qWarning() << "TiffRegionReader: Invalid block layout in" << path;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void TiffRegionReader::close() {
+    if (m_tiff) {
+        TIFFClose(m_tiff);
+        m_tiff = nullptr;
+    }
+    m_path.clear();
+    m_width = m_height = m_channels = 0;
+    m_blockWidth = m_blockHeight = 0;
+    m_blockBytes = 0;
+}
+
+QRect TiffRegionReader::blockRect(const QPoint& block) const {
+    const int x = block.x() * m_blockWidth;
+    const int y = block.y() * m_blockHeight;
+    return QRect(x, y, std::min(m_blockWidth, m_width - x), std::min(m_blockHeight, m_height - y));
+}
+
+bool TiffRegionReader::decodeBlocks(const QVector<QPoint>& blocks,
+                                    const std::function<void(const QPoint&, const uchar*)>& consume) const {
+    if (!m_tiff || blocks.isEmpty()) {
+        return m_tiff != nullptr;
+    }
+
+    // A libtiff handle is not thread safe, so each chunk of blocks gets its
+    // own; the first chunk reuses the handle opened for the tags. The calling
+    // thread decodes a chunk too.
+    const int chunkCount = std::max(1, std::min<int>(m_pool->maxThreadCount() + 1, blocks.size()));
+    QVector<int> chunks(chunkCount);
+    std::iota(chunks.begin(), chunks.end(), 0);
+
+    std::atomic<bool> ok(true);
+    QtConcurrent::blockingMap(m_pool, chunks, [&](int chunk) {
+        const int begin = static_cast<int>(static_cast<qint64>(blocks.size()) * chunk / chunkCount);
+        const int end = static_cast<int>(static_cast<qint64>(blocks.size()) * (chunk + 1) / chunkCount);
+
+        TIFF* tiff = chunk == 0 ? m_tiff : TIFFOpen(QFile::encodeName(m_path).constData(), "r");
+        if (!tiff) {
+            ok = false;
+            return;
+        }
+
+        std::vector<uchar> buffer(static_cast<size_t>(m_blockBytes));
+        for (int i = begin; i < end && ok; ++i) {
+            const QPoint& block = blocks[i];
+            const uint32_t x = static_cast<uint32_t>(block.x() * m_blockWidth);
+            const uint32_t y = static_cast<uint32_t>(block.y() * m_blockHeight);
+            const tmsize_t read = m_tiled
+                ? TIFFReadEncodedTile(tiff, TIFFComputeTile(tiff, x, y, 0, 0), buffer.data(), -1)
+                : TIFFReadEncodedStrip(tiff, TIFFComputeStrip(tiff, y, 0), buffer.data(), -1);
+            if (read < 0) {
+                qWarning() << "TiffRegionReader: Cannot decode block" << block << "of" << m_path;
+                ok = false;
+                break;
+            }
+            consume(block, buffer.data());
+        }
+
+        if (tiff != m_tiff) {
+            TIFFClose(tiff);
+        }
+    });
+    return ok;
+}
+
+bool TiffRegionReader::readRegion(const QRect& rect, cv::Mat& region) {
+    const QRect area = rect.intersected(QRect(0, 0, m_width, m_height));
+    if (!m_tiff || area.isEmpty()) {
+        return false;
+    }
+
+    region.create(area.height(), area.width(), CV_8UC(m_channels));
+
+    QVector<QPoint> blocks;
+    for (int row = area.top() / m_blockHeight; row <= area.bottom() / m_blockHeight; ++row) {
+        for (int col = area.left() / m_blockWidth; col <= area.right() / m_blockWidth; ++col) {
+            blocks.append(QPoint(col, row));
+        }
+    }
+
+    const size_t stride = static_cast<size_t>(m_blockWidth) * m_channels;
+    const bool ok = decodeBlocks(blocks, [&](const QPoint& block, const uchar* data) {
+        const QRect bounds = blockRect(block);
+        const QRect overlap = bounds.intersected(area);
+        const size_t bytes = static_cast<size_t>(overlap.width()) * m_channels;
+        for (int y = overlap.top(); y <= overlap.bottom(); ++y) {
+            const uchar* src = data + (y - bounds.top()) * stride + (overlap.left() - bounds.left()) * m_channels;
+            std::memcpy(region.ptr(y - area.top()) + (overlap.left() - area.left()) * m_channels, src, bytes);
+        }
+    });
+    if (!ok) {
+        region.release();
+        return false;
+    }
+
+    if (m_channels == 3) {
+        cv::cvtColor(region, region, cv::COLOR_RGB2BGR);
+    }
+    return true;
+}
+
+bool TiffRegionReader::readPreview(int scale, cv::Mat& preview) {
+    if (!m_tiff || scale < 1) {
+        return false;
+    }
+
+    const int previewWidth = std::max(1, m_width / scale);
+    const int previewHeight = std::max(1, m_height / scale);
+
+    // One full-width row from the middle of every band of scale rows
+    QVector<int> sampleRows(previewHeight);
+    QVector<QPoint> blocks;
+    const int blockColumns = (m_width + m_blockWidth - 1) / m_blockWidth;
+    int lastBlockRow = -1;
+    for (int r = 0; r < previewHeight; ++r) {
+        sampleRows[r] = std::min(r * scale + scale / 2, m_height - 1);
+        const int blockRow = sampleRows[r] / m_blockHeight;
+        if (blockRow != lastBlockRow) {
+            for (int col = 0; col < blockColumns; ++col) {
+                blocks.append(QPoint(col, blockRow));
+            }
+            lastBlockRow = blockRow;
+        }
+    }
+
+    cv::Mat rows(previewHeight, m_width, CV_8UC(m_channels));
+    const size_t stride = static_cast<size_t>(m_blockWidth) * m_channels;
+    const bool ok = decodeBlocks(blocks, [&](const QPoint& block, const uchar* data) {
+        const QRect bounds = blockRect(block);
+        // Sample rows are ascending, so the ones inside this block are contiguous
+        auto first = std::lower_bound(sampleRows.cbegin(), sampleRows.cend(), bounds.top());
+        for (auto it = first; it != sampleRows.cend() && *it <= bounds.bottom(); ++it) {
+            const uchar* src = data + (*it - bounds.top()) * stride;
+            std::memcpy(rows.ptr(static_cast<int>(it - sampleRows.cbegin())) + bounds.left() * m_channels,
+                        src, static_cast<size_t>(bounds.width()) * m_channels);
+        }
+    });
+    if (!ok) {
+        return false;
+    }
+
+    cv::resize(rows, preview, cv::Size(previewWidth, previewHeight), 0, 0, cv::INTER_AREA);
+    if (m_channels == 3) {
+        cv::cvtColor(preview, preview, cv::COLOR_RGB2BGR);
+    }
+    return true;
+}
@@ -0,0 +1,116 @@
+#include "UsbHotplugMonitor.h"
+#include <QSocketNotifier>
+#include <QByteArray>
+#include <QList>
+#include <QDebug>
+
+#ifdef Q_OS_LINUX
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace {
+// Kernel uevent multicast group (udev rebroadcasts on group 2 in its own format)
+constexpr unsigned int kKernelEventGroup = 1;
+constexpr int kEventBufferSize = 8192;
+}
+
+UsbHotplugMonitor::UsbHotplugMonitor(QObject* parent)
+    : QObject(parent)
+    , m_socket(-1)
+    , m_notifier(nullptr)
+{
+}
+
+UsbHotplugMonitor::~UsbHotplugMonitor() {
+#ifdef Q_OS_LINUX
+    if (m_socket >= 0) {
+        close(m_socket);
+    }
+#endif
+}
+
+bool UsbHotplugMonitor::start() {
+    if (m_socket >= 0) {
+        return true;
+    }
+
+#ifdef Q_OS_LINUX
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    if (fd < 0) {
+        qWarning() << "USB hotplug: Cannot create netlink socket:" << strerror(errno);
+        return false;
+    }
+
+    sockaddr_nl addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = kKernelEventGroup;
+
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        qWarning() << "USB hotplug: Cannot bind netlink socket:" << strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    m_socket = fd;
+    m_notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &UsbHotplugMonitor::onReadable);
+
+    qInfo() << "USB hotplug monitoring started";
+    return true;
+#else
+    qInfo() << "USB hotplug monitoring not available on this platform";
+    return false;
+#endif
+}
+
+bool UsbHotplugMonitor::isRunning() const {
+    return m_socket >= 0;
+}
+
+void UsbHotplugMonitor::onReadable() {
+#ifdef Q_OS_LINUX
+    char buffer[kEventBufferSize];
+
+    while (true) {
+        ssize_t length = recv(m_socket, buffer, sizeof(buffer) - 1, 0);
+        if (length <= 0) {
+            break;
+        }
+        buffer[length] = '\0';
+
+        // "action@devpath" followed by NUL-separated KEY=value pairs
+        const QList<QByteArray> fields = QByteArray(buffer, static_cast<int>(length)).split('\0');
+
+        QString action;
+        QString subsystem;
+        QString devType;
+        QString product;
+        for (const QByteArray& field : fields) {
+            if (field.startsWith("ACTION=")) {
+                action = QString::fromLatin1(field.mid(7));
+            } else if (field.startsWith("SUBSYSTEM=")) {
+                subsystem = QString::fromLatin1(field.mid(10));
+            } else if (field.startsWith("DEVTYPE=")) {
+                devType = QString::fromLatin1(field.mid(8));
+            } else if (field.startsWith("PRODUCT=")) {
+                product = QString::fromLatin1(field.mid(8));
+            }
+        }
+
+        // Interfaces of the same device report too; only whole devices matter
+        if (subsystem != "usb" || devType != "usb_device") {
+            continue;
+        }
+
+        if (action == "add" || action == "remove") {
+            qInfo() << "USB hotplug:" << action << product;
+            emit usbDeviceChanged(action, product);
+        }
+    }
+#endif
+}
@@ -4,6 +4,7 @@
 #include <QDebug>
 #include "AppController.h"
 #include "AppSettings.h"
+#include "MatBufferPool.h"
 
 int main(int argc, char *argv[]) {
     QGuiApplication app(argc, argv);
@@ -43,6 +44,13 @@ int main(int argc, char *argv[]) {
         qInfo() << "";
     }
 
+    // Image buffers are recycled from the first scan on; eight full frames
+    // cover a page, its crop and intermediates on every processing worker
+    if (settings.bufferPool) {
+        const size_t frameBytes = static_cast<size_t>(settings.cropX2) * settings.cropY2 * 3;
+        MatBufferPool::install(8 * frameBytes);
+    }
+
     // Create application controller
     AppController controller(&settings);
 